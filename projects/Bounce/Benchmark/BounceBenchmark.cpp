@@ -0,0 +1,318 @@
+// headless Bounce benchmark : runs the ball simulation without the kigs framework, for fixed seeds,
+// and prints results as JSON, so physics performance and correctness can be compared between runs
+//
+// usage : BounceBenchmark [--balls 50,1000,...] [--time T] [--step S] [--seed N] [--threads 1,4,...] [--size WxH]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "BounceSimulation.h"
+
+using namespace Kigs;
+
+// the application area and ball count : default sizes keep the same ball density
+const float AppSizeX = 1280.0f;
+const float AppSizeY = 800.0f;
+const int AppBallCount = 50;
+
+// relative tolerances of the conservation checks (speeds are floats)
+const double EnergyTolerance = 1.0e-4;
+const double MomentumTolerance = 1.0e-4;
+// interpenetration (or distance out of the walls) over this distance is reported
+const float OverlapTolerance = 0.5f;
+
+struct Result
+{
+	int			balls;
+	int			threads;
+	float		sizeX;
+	float		sizeY;
+	double		simulatedTime;
+	double		wallTime;
+	uint64_t	ballCollisions;
+	uint64_t	wallCollisions;
+	double		collisionsPerSecond;
+	double		energyDrift;
+	double		momentumError;
+	int			overlaps;
+	int			escapes;
+	uint32_t	checksum;
+	bool		ok;
+};
+
+static std::vector<int>	parseIntList(const char* arg)
+{
+	std::vector<int> result;
+	const char* current = arg;
+	while (*current)
+	{
+		result.push_back(atoi(current));
+		const char* comma = strchr(current, ',');
+		if (!comma)
+		{
+			break;
+		}
+		current = comma + 1;
+	}
+	return result;
+}
+
+// balls on a grid as in the application, with random radius (16 to 47, reduced to fit the grid) and speed.
+// std::mt19937 output is the same on all platforms (distributions are not, so they are not used)
+static void	initBalls(BallStore& balls, int count, float sizeX, float sizeY, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	int columns = std::max((int)ceil(sqrt((double)count * sizeX / sizeY)), 1);
+	int rows = (count + columns - 1) / columns;
+	float spacing = std::min(sizeX / (columns + 1), sizeY / (rows + 1));
+
+	balls.Clear();
+	for (int k = 0; k < count; k++)
+	{
+		float r = std::min(16.0f + (random() % 32), spacing * 0.45f);
+		int b = balls.Add(r, r * r);
+		balls.SetPos(b, spacing * (k % columns + 1), spacing * (k / columns + 1));
+		balls.SetSpeed(b, (float)((int)(random() % 513) - 256), (float)((int)(random() % 513) - 256));
+	}
+}
+
+static double	kineticEnergy(const BallStore& balls)
+{
+	double energy = 0.0;
+	for (int i = 0; i < balls.Size(); i++)
+	{
+		energy += 0.5 * balls.mMass[i] * ((double)balls.mSpeedX[i] * balls.mSpeedX[i] + (double)balls.mSpeedY[i] * balls.mSpeedY[i]);
+	}
+	return energy;
+}
+
+// count interpenetrating ball pairs at time, with a grid of the ball bounds
+static int	countOverlaps(const BallStore& balls, double time, float sizeX, float sizeY)
+{
+	int count = balls.Size();
+	std::vector<float> posX(count), posY(count);
+	float radiusSum = 0.0f;
+	CollisionBounds area = { 0.0f, 0.0f, sizeX, sizeY };
+	for (int i = 0; i < count; i++)
+	{
+		posX[i] = (float)balls.GetPosX(i, time);
+		posY[i] = (float)balls.GetPosY(i, time);
+		radiusSum += balls.mRadius[i];
+	}
+
+	CollisionGrid grid;
+	grid.Reset(area, count ? 2.0f * radiusSum / count : 1.0f, count);
+	for (int i = 0; i < count; i++)
+	{
+		float r = balls.mRadius[i];
+		grid.Insert(i, { posX[i] - r, posY[i] - r, posX[i] + r, posY[i] + r });
+	}
+
+	int overlaps = 0;
+	for (int i = 0; i < count; i++)
+	{
+		grid.QueryObject(i, [&](int j)
+			{
+				float dx = posX[i] - posX[j];
+				float dy = posY[i] - posY[j];
+				if ((j < i) && (sqrtf(dx * dx + dy * dy) < balls.mRadius[i] + balls.mRadius[j] - OverlapTolerance))
+				{
+					overlaps++;
+				}
+			});
+	}
+	return overlaps;
+}
+
+// FNV-1a hash of the final positions and speeds, equal between runs if the simulation is deterministic
+static uint32_t	stateChecksum(const BallStore& balls, double time)
+{
+	uint32_t hash = 2166136261u;
+	auto add = [&](float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		for (int b = 0; b < 4; b++)
+		{
+			hash = (hash ^ ((bits >> (b * 8)) & 0xFF)) * 16777619u;
+		}
+	};
+	for (int i = 0; i < balls.Size(); i++)
+	{
+		add((float)balls.GetPosX(i, time));
+		add((float)balls.GetPosY(i, time));
+		add(balls.mSpeedX[i]);
+		add(balls.mSpeedY[i]);
+	}
+	return hash;
+}
+
+static Result	runSimulation(int ballCount, int threads, float sizeX, float sizeY, double simulatedTime, double step, uint32_t seed)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+
+	BounceSimulation simulation;
+	initBalls(simulation.GetBalls(), ballCount, sizeX, sizeY, seed);
+	simulation.AddWall(Wall(0.0f, 0.0f, 1.0f, 0.0f));
+	simulation.AddWall(Wall(0.0f, 0.0f, 0.0f, 1.0f));
+	simulation.AddWall(Wall(sizeX, 0.0f, -1.0f, 0.0f));
+	simulation.AddWall(Wall(0.0f, sizeY, 0.0f, -1.0f));
+	double startEnergy = kineticEnergy(simulation.GetBalls());
+
+	// same update loop as the application, at a fixed frame rate
+	auto start = std::chrono::steady_clock::now();
+	simulation.Start(0.0);
+	int stepCount = (int)ceil(simulatedTime / step - 1.0e-9);
+	for (int s = 1; s <= stepCount; s++)
+	{
+		simulation.Update(std::min(s * step, simulatedTime));
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const BallStore& balls = simulation.GetBalls();
+	const BounceStats& stats = simulation.GetStats();
+
+	Result result;
+	result.balls = ballCount;
+	result.threads = threads;
+	result.sizeX = sizeX;
+	result.sizeY = sizeY;
+	result.simulatedTime = simulatedTime;
+	result.wallTime = elapsed.count();
+	result.ballCollisions = stats.mBallCollisions;
+	result.wallCollisions = stats.mWallCollisions;
+	result.collisionsPerSecond = (result.wallTime > 0.0) ? (double)(stats.mBallCollisions + stats.mWallCollisions) / result.wallTime : 0.0;
+	result.energyDrift = (startEnergy > 0.0) ? fabs(kineticEnergy(balls) - startEnergy) / startEnergy : 0.0;
+	result.momentumError = stats.mMaxMomentumError;
+	result.overlaps = countOverlaps(balls, simulatedTime, sizeX, sizeY);
+	result.escapes = 0;
+	for (int i = 0; i < ballCount; i++)
+	{
+		double x = balls.GetPosX(i, simulatedTime);
+		double y = balls.GetPosY(i, simulatedTime);
+		double limit = balls.mRadius[i] - OverlapTolerance;
+		if ((x < limit) || (y < limit) || (x > sizeX - limit) || (y > sizeY - limit))
+		{
+			result.escapes++;
+		}
+	}
+	result.checksum = stateChecksum(balls, simulatedTime);
+	result.ok = (result.energyDrift <= EnergyTolerance) && (result.momentumError <= MomentumTolerance) && (result.overlaps == 0) && (result.escapes == 0);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> ballCounts = { 50, 1000, 10000 };
+	std::vector<int> threads;
+	double simulatedTime = 10.0;
+	double step = 1.0 / 60.0;
+	uint32_t seed = 1;
+	float sizeX = 0.0f;
+	float sizeY = 0.0f;
+
+#ifdef _OPENMP
+	int maxThreads = omp_get_max_threads();
+#else
+	int maxThreads = 1;
+#endif
+	threads.push_back(1);
+	if (maxThreads > 1)
+	{
+		threads.push_back(maxThreads);
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1) < argc;
+		if ((strcmp(argv[i], "--balls") == 0) && hasValue)
+		{
+			ballCounts = parseIntList(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--time") == 0) && hasValue)
+		{
+			simulatedTime = std::max(0.0, atof(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--step") == 0) && hasValue)
+		{
+			step = std::max(1.0e-6, atof(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--seed") == 0) && hasValue)
+		{
+			seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "--threads") == 0) && hasValue)
+		{
+			threads = parseIntList(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--size") == 0) && hasValue)
+		{
+			if (sscanf(argv[++i], "%fx%f", &sizeX, &sizeY) != 2)
+			{
+				sizeX = sizeY = 0.0f;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "usage : %s [--balls 50,1000,...] [--time T] [--step S] [--seed N] [--threads 1,4,...] [--size WxH]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for (int ballCount : ballCounts)
+	{
+		if (ballCount < 1)
+		{
+			continue;
+		}
+		// default area has the application ball density
+		float scale = sqrtf((float)ballCount / (float)AppBallCount);
+		float areaX = (sizeX > 0.0f) ? sizeX : AppSizeX * scale;
+		float areaY = (sizeY > 0.0f) ? sizeY : AppSizeY * scale;
+		for (int threadCount : threads)
+		{
+			if (threadCount < 1)
+			{
+				continue;
+			}
+			fprintf(stderr, "%d balls %.0fx%.0f %d thread(s)...\n", ballCount, areaX, areaY, threadCount);
+			results.push_back(runSimulation(ballCount, threadCount, areaX, areaY, simulatedTime, step, seed));
+		}
+	}
+
+	bool allOk = true;
+	printf("{\n");
+	printf("  \"benchmark\": \"Bounce\",\n");
+	printf("  \"time\": %.3f,\n", simulatedTime);
+	printf("  \"step\": %.6f,\n", step);
+	printf("  \"seed\": %u,\n", seed);
+	printf("  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		allOk = allOk && r.ok;
+		printf("    { \"balls\": %d, \"threads\": %d, \"width\": %.0f, \"height\": %.0f, "
+			"\"wall_time\": %.3f, \"ball_collisions\": %llu, \"wall_collisions\": %llu, \"collisions_per_second\": %.0f, "
+			"\"energy_drift\": %.3g, \"momentum_error\": %.3g, \"overlaps\": %d, \"escapes\": %d, "
+			"\"checksum\": \"%08x\", \"ok\": %s }%s\n",
+			r.balls, r.threads, r.sizeX, r.sizeY,
+			r.wallTime, (unsigned long long)r.ballCollisions, (unsigned long long)r.wallCollisions, r.collisionsPerSecond,
+			r.energyDrift, r.momentumError, r.overlaps, r.escapes,
+			r.checksum, r.ok ? "true" : "false", (i + 1 < results.size()) ? "," : "");
+	}
+	printf("  ]\n");
+	printf("}\n");
+	return allOk ? 0 : 2;
+}
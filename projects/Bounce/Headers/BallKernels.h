@@ -0,0 +1,17 @@
+#pragma once
+
+#include "BallStore.h"
+
+namespace Kigs
+{
+	// contact times of ball i with each ball of others (count indices) : the two balls touch (their distance is
+	// the sum of their radii) at enter[k] and exit[k], with enter[k] < exit[k], both times can be before time.
+	// enter[k] = exit[k] = -1 if the balls never touch.
+	// Positions are extrapolated from time in double precision, others are tested by SIMD batches
+	// (AVX2 / AVX512 selected at runtime), nothing is allocated
+	void	BallCollisionTimes(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit);
+
+	// time ball i touches the wall (position and unit normal pointing inside), or -1 if it's not moving to the wall
+	// or already past it
+	double	BallWallCollisionTime(const BallStore& balls, int i, float wallX, float wallY, float normalX, float normalY, double time);
+}
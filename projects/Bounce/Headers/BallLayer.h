@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace Kigs
+{
+	// all balls drawn in one RGBA pixel buffer, shown by a single bitmap texture :
+	// no UI item (and its attribute writes) per ball, but the discs are rasterised on the CPU and the whole
+	// bitmap is uploaded each frame. Colors are packed as in the Mandelbrot bitmap : R | G << 8 | B << 16 | A << 24
+	class BallLayer
+	{
+	public:
+
+		// draw count discs (ellipses when the bitmap is scaled differently on each axis) in pixels (sizeX * sizeY * 4 bytes),
+		// positions and radius on each axis in pixels. Discs have anti-aliased edges and are blended over each other in array order.
+		// pixels must hold the previous frame drawn by this layer : only the horizontal bands whose balls changed
+		// are cleared and drawn again
+		void	Draw(unsigned char* pixels, int sizeX, int sizeY, const float* posX, const float* posY, const float* radiusX, const float* radiusY, const uint32_t* colors, int count);
+
+		// draw every band on next Draw (pixels were modified by something else)
+		void	Invalidate()
+		{
+			mBandSignature.clear();
+		}
+
+	protected:
+
+		// balls are sorted in horizontal bands of pixels, bands are drawn in parallel
+		std::vector<int>		mBandStart;
+		std::vector<int>		mBandBalls;
+		std::vector<int>		mBandFill;
+		// hash of the balls drawn in each band by the last Draw, and the pixel buffer it was drawn in
+		std::vector<uint32_t>	mBandSignature;
+		const unsigned char*	mPixels = nullptr;
+		int						mSizeX = 0;
+		int						mSizeY = 0;
+	};
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+namespace Kigs
+{
+	// ball physics data stored as structure of arrays, so that collision kernels load several balls at once.
+	// Ball i is at (mPosX[i], mPosY[i]) at time mResetTime[i], then moves at constant speed
+	struct BallStore
+	{
+		std::vector<float>	mPosX;
+		std::vector<float>	mPosY;
+		std::vector<float>	mSpeedX;
+		std::vector<float>	mSpeedY;
+		std::vector<float>	mRadius;
+		std::vector<float>	mMass;
+		std::vector<double>	mResetTime;
+
+		// add a ball at (0,0) with null speed, return its index
+		int	Add(float r, float m)
+		{
+			mPosX.push_back(0.0f);
+			mPosY.push_back(0.0f);
+			mSpeedX.push_back(0.0f);
+			mSpeedY.push_back(0.0f);
+			mRadius.push_back(r);
+			mMass.push_back(m);
+			mResetTime.push_back(0.0);
+			return Size() - 1;
+		}
+
+		void	Clear()
+		{
+			mPosX.clear();
+			mPosY.clear();
+			mSpeedX.clear();
+			mSpeedY.clear();
+			mRadius.clear();
+			mMass.clear();
+			mResetTime.clear();
+		}
+
+		int	Size() const
+		{
+			return (int)mRadius.size();
+		}
+
+		void	SetPos(int i, float x, float y)
+		{
+			mPosX[i] = x;
+			mPosY[i] = y;
+		}
+
+		void	SetSpeed(int i, float x, float y)
+		{
+			mSpeedX[i] = x;
+			mSpeedY[i] = y;
+		}
+
+		double	GetPosX(int i, double t) const
+		{
+			return mPosX[i] + (t - mResetTime[i]) * mSpeedX[i];
+		}
+
+		double	GetPosY(int i, double t) const
+		{
+			return mPosY[i] + (t - mResetTime[i]) * mSpeedY[i];
+		}
+
+		// set ball i position to its position at time t, and t as its reset time (before a speed change)
+		void	MoveTo(int i, double t)
+		{
+			SetPos(i, (float)GetPosX(i, t), (float)GetPosY(i, t));
+			mResetTime[i] = t;
+		}
+	};
+}
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "DataDrivenBaseApplication.h"
-#include "Ball.h"
+#include "KigsBitmap.h"
+#include "BounceSimulation.h"
+#include "BallLayer.h"
 
 namespace Kigs
 {
+	using namespace Kigs::Core;
 	using namespace Kigs::DDriven;
 	class Bounce : public DataDrivenBaseApplication
 	{
@@ -21,38 +24,22 @@ namespace Kigs
 		void	ProtectedInitSequence(const std::string& sequence) override;
 		void	ProtectedCloseSequence(const std::string& sequence) override;
 
-		// ball list
-		std::vector<Ball>		mBalls;
-		// wall list
-		std::vector<Wall>		mWalls;
-
-		// graphic display
-		CMSP					mMainInterface;
+		// balls and walls
+		BounceSimulation		mSimulation;
+		// ball display : all balls are drawn in one bitmap
+		SP<Draw::KigsBitmap>	mBitmap;
+		BallLayer				mBallLayer;
+		// ball positions and radius (on each axis) in bitmap pixels, and colors
+		std::vector<float>		mLayerPosX;
+		std::vector<float>		mLayerPosY;
+		std::vector<float>		mLayerRadiusX;
+		std::vector<float>		mLayerRadiusY;
+		std::vector<uint32_t>	mBallColors;
 
 		// simulation time management
 		double					mFirstTime = -1.0;
-		double					mPreviousTime = -1.0;
-		// search all possible future collisions with current trajectories
-		void	FindFutureCollisions(double time);
-
-		// check if new trajectories need to be computed (collision occur), if yes compute them and return true 
-		// else return false
-		bool	computeNewTrajectories(double currentTime);
 
 		void	resetAll(double currentTime);
-
-		// structure to hold collisions
-		class collisionStruct
-		{
-		public:
-			double	mCollisionTime;
-			Ball* mBall1 = nullptr;
-			Ball* mBall2 = nullptr;
-			Wall* mWall = nullptr;
-		};
-		// future collision list
-		std::vector<collisionStruct>	mFutureCollisions;
-
 	};
 
 }
@@ -0,0 +1,52 @@
+#pragma once
+
+// x86 SIMD collision kernels are selected at runtime, other platforms use the scalar path
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && !defined(__EMSCRIPTEN__)
+#define BOUNCE_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BOUNCE_TARGET(isa)
+#else
+#define BOUNCE_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// check both CPU and OS support (AVX state saved by the OS)
+inline bool	BounceCPUSupports(bool wantAVX512)
+{
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(regs, 1);
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+	{
+		return false;
+	}
+	unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6) // XMM and YMM state
+	{
+		return false;
+	}
+	__cpuidex(regs, 7, 0);
+	if (wantAVX512)
+	{
+		return ((regs[1] & (1 << 16)) != 0) && ((xcr0 & 0xE0) == 0xE0); // AVX512F and opmask/ZMM state
+	}
+	return (regs[1] & (1 << 5)) != 0; // AVX2
+#else
+	__builtin_cpu_init();
+	if (wantAVX512)
+	{
+		return __builtin_cpu_supports("avx512f");
+	}
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // BOUNCE_X86_SIMD
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "BallStore.h"
+#include "Wall.h"
+#include "CollisionGrid.h"
+
+namespace Kigs
+{
+	// counters since the simulation start
+	struct BounceStats
+	{
+		uint64_t	mBallCollisions = 0;
+		uint64_t	mWallCollisions = 0;
+		// largest momentum change of a ball / ball collision, relative to the pair momentum norm
+		double		mMaxMomentumError = 0.0;
+	};
+
+	// event driven simulation of balls bouncing on each other and on walls (no kigs framework dependency).
+	// Balls and walls are set, then Start is called, then Update is called with increasing times
+	class BounceSimulation
+	{
+	public:
+
+		BallStore&			GetBalls()
+		{
+			return mBalls;
+		}
+		const BallStore&	GetBalls() const
+		{
+			return mBalls;
+		}
+
+		void	AddWall(const Wall& wall)
+		{
+			mWalls.push_back(wall);
+		}
+		const std::vector<Wall>&	GetWalls() const
+		{
+			return mWalls;
+		}
+
+		const BounceStats&	GetStats() const
+		{
+			return mStats;
+		}
+
+		// search all collisions from the given time
+		void	Start(double time)
+		{
+			FindFutureCollisions(time);
+		}
+
+		// apply all collisions occuring up to currentTime
+		void	Update(double currentTime);
+
+		// time of the next known collision, collisions after the horizon are not known yet
+		double	GetNextCollisionTime();
+
+		// set all balls at their currentTime position and restart the simulation at time 0
+		void	Rebase(double currentTime);
+
+	protected:
+
+		// ball list
+		BallStore				mBalls;
+		// wall list
+		std::vector<Wall>		mWalls;
+
+		// last simulation time
+		double					mPreviousTime = -1.0;
+
+		BounceStats				mStats;
+
+		// search all possible future collisions with current trajectories, up to a new horizon.
+		// Balls are searched in parallel, each pair once (by its highest ball index)
+		void	FindFutureCollisions(double time);
+
+		// search future collisions of the given ball with current trajectories
+		// (collisions with balls in ignoreBalls are not searched, they are found by their own call)
+		void	findBallCollisions(int ball, double time, const int* ignoreBalls, int ignoreCount);
+
+		// ball bounds over the trajectory from time to the horizon
+		CollisionBounds	getSweptBounds(int ball, double time) const;
+
+		// check if new trajectories need to be computed (collision occur), if yes compute them and return true 
+		// else return false
+		bool	computeNewTrajectories(double currentTime);
+
+		// structure to hold collisions : a collision is obsolete when one of its balls collided since it was found
+		class collisionStruct
+		{
+		public:
+			double	mCollisionTime;
+			int		mBall1 = -1;
+			int		mBall2 = -1;
+			int		mWall = -1;
+			// collision count of the balls when the collision was found
+			unsigned int	mCount1 = 0;
+			unsigned int	mCount2 = 0;
+
+			// heap order : earliest collision first, ties by balls and wall index so order is deterministic
+			bool	operator>(const collisionStruct& other) const
+			{
+				if (mCollisionTime != other.mCollisionTime)
+				{
+					return mCollisionTime > other.mCollisionTime;
+				}
+				if (mBall1 != other.mBall1)
+				{
+					return mBall1 > other.mBall1;
+				}
+				if (mBall2 != other.mBall2)
+				{
+					return mBall2 > other.mBall2;
+				}
+				return mWall > other.mWall;
+			}
+		};
+
+		void	addCollision(const collisionStruct& collision);
+		// remove obsolete collisions from the heap top, return false if the heap is empty
+		bool	popObsoleteCollisions();
+
+		// event driven simulation : future collisions min heap (std::push_heap with std::greater order)
+		// only the collisions of balls involved in a collision are searched again
+		std::vector<collisionStruct>	mFutureCollisions;
+		// collision count of each ball
+		std::vector<unsigned int>		mCollisionCounts;
+
+		// broad phase : balls are registered with their bounds up to the horizon,
+		// all collisions are searched again when the simulation reaches it
+		CollisionGrid					mGrid;
+		double							mHorizon = 0.0;
+
+		// collision search buffers of one thread : balls tested against one ball by the collision kernel,
+		// their contact times, and the collisions found
+		struct collisionSearch
+		{
+			std::vector<int>				mCandidates;
+			std::vector<double>				mEnter;
+			std::vector<double>				mExit;
+			std::vector<collisionStruct>	mCollisions;
+		};
+		// one per thread, the first one is also used by the serial search
+		std::vector<collisionSearch>	mSearches;
+
+		// collision time of ball i with search.mCandidates balls (in search.mEnter), -1 if they don't bounce after time
+		void	getBallCollisionTimes(int i, double time, collisionSearch& search) const;
+		// add collisions of ball i (after time) with search.mCandidates balls and with walls to search.mCollisions
+		void	searchBallCollisions(int i, double time, collisionSearch& search) const;
+
+	};
+}
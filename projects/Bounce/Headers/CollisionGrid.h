@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+namespace Kigs
+{
+	// axis aligned box
+	struct CollisionBounds
+	{
+		float	mMinX = 0.0f;
+		float	mMinY = 0.0f;
+		float	mMaxX = 0.0f;
+		float	mMaxY = 0.0f;
+
+		bool	Overlap(const CollisionBounds& other) const
+		{
+			return (mMinX <= other.mMaxX) && (other.mMinX <= mMaxX) && (mMinY <= other.mMaxY) && (other.mMinY <= mMaxY);
+		}
+	};
+
+	// uniform grid broad phase : each object is registered in all the cells its bounds cover,
+	// so only objects sharing a cell are tested against each other.
+	// Bounds outside the grid area are clamped to the border cells (overlapping bounds still share a cell)
+	class CollisionGrid
+	{
+	public:
+
+		// set grid area and cell size, and remove all objects (ids are 0 to objectCount - 1)
+		void	Reset(const CollisionBounds& area, float cellSize, int objectCount);
+
+		void	Insert(int id, const CollisionBounds& bounds);
+		void	Remove(int id);
+
+		void	Update(int id, const CollisionBounds& bounds)
+		{
+			Remove(id);
+			Insert(id, bounds);
+		}
+
+		// call found(id) once for each registered object whose bounds overlap the given bounds
+		template<typename F>
+		void	Query(const CollisionBounds& bounds, F found)
+		{
+			cellRange range = getCellRange(bounds);
+			unsigned int mark = nextQueryMark();
+			for (int y = range.mY0; y <= range.mY1; y++)
+			{
+				for (int x = range.mX0; x <= range.mX1; x++)
+				{
+					for (int id : mCells[y * mCellCountX + x])
+					{
+						if ((mQueryMarks[id] != mark) && bounds.Overlap(mBounds[id]))
+						{
+							mQueryMarks[id] = mark;
+							found(id);
+						}
+					}
+				}
+			}
+		}
+
+		// call found(other) once for each other registered object whose bounds overlap the ones of registered object id.
+		// A pair is only reported in the first cell both objects cover, so no query mark is needed :
+		// the grid is not modified and several threads can search at the same time
+		template<typename F>
+		void	QueryObject(int id, F found) const
+		{
+			const cellRange& range = mRanges[id];
+			const CollisionBounds& bounds = mBounds[id];
+			for (int y = range.mY0; y <= range.mY1; y++)
+			{
+				for (int x = range.mX0; x <= range.mX1; x++)
+				{
+					for (int other : mCells[y * mCellCountX + x])
+					{
+						const cellRange& otherRange = mRanges[other];
+						if ((other != id) && (x == std::max(range.mX0, otherRange.mX0)) && (y == std::max(range.mY0, otherRange.mY0)) && bounds.Overlap(mBounds[other]))
+						{
+							found(other);
+						}
+					}
+				}
+			}
+		}
+
+	protected:
+
+		struct cellRange
+		{
+			int	mX0;
+			int	mY0;
+			int	mX1;
+			int	mY1;
+		};
+
+		cellRange		getCellRange(const CollisionBounds& bounds) const;
+		unsigned int	nextQueryMark();
+
+		std::vector<std::vector<int>>	mCells;
+		int								mCellCountX = 0;
+		int								mCellCountY = 0;
+		float							mOriginX = 0.0f;
+		float							mOriginY = 0.0f;
+		float							mOneOnCellSize = 1.0f;
+
+		// registered bounds and covered cells of each object (empty range if not registered)
+		std::vector<CollisionBounds>	mBounds;
+		std::vector<cellRange>			mRanges;
+
+		// objects already found by the current query
+		std::vector<unsigned int>		mQueryMarks;
+		unsigned int					mQueryMark = 0;
+	};
+}
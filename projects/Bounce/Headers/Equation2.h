@@ -1,9 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <math.h>
 
 namespace Kigs
 {
+	// roots of a second degree equation, no allocation
+	struct Equation2Roots
+	{
+		double	mRoots[2] = { 0.0, 0.0 };
+		// 0, 1 (null delta) or 2 roots, the root with the largest magnitude first
+		int		mCount = 0;
+	};
 
 	// manage second degree equation 
 	class Equation2
@@ -14,9 +22,6 @@ namespace Kigs
 		double	mB;
 		double	mC;
 
-		// compute delta for given Y
-		double delta(double Y);
-
 	public:
 		// init equation
 		Equation2(double a, double b, double c) : mA(a), mB(b), mC(c)
@@ -32,8 +37,58 @@ namespace Kigs
 			mC = c;
 		}
 
+		// at^2 + bt + c = 0, a must not be 0
+		static inline Equation2Roots	SolveRoots(double a, double b, double c)
+		{
+			Equation2Roots result;
+
+			// delta = b^2 - 4 * a * c
+			double d = b * b - 4.0 * a * c;
+			if (d < 0.0) // no solution
+			{
+				return result;
+			}
+
+			// for precision : first root without cancellation between -b and sqrt(delta)
+			double r1;
+			if (b < 0.0)
+			{
+				r1 = (-b + sqrt(d)) / (2.0 * a);
+			}
+			else
+			{
+				r1 = (-b - sqrt(d)) / (2.0 * a);
+			}
+			result.mRoots[0] = r1;
+			result.mCount = 1;
+
+			if (d > 0.0)
+			{
+				// roots product is c/a
+				result.mRoots[1] = c / (a * r1);
+				result.mCount = 2;
+			}
+			return result;
+		}
+
+		// solve count equations a[i]t^2 + b[i]t + c[i] = 0
+		static inline void	SolveRoots(const double* a, const double* b, const double* c, int count, Equation2Roots* roots)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				roots[i] = SolveRoots(a[i], b[i], c[i]);
+			}
+		}
+
+		// solve equation for given Y
+		Equation2Roots	SolveRoots(double forY = 0.0) const
+		{
+			// at^2 + bt + c = Y <=> at^2 + bt + c-Y = 0
+			return SolveRoots(mA, mB, mC - forY);
+		}
+
 		// solve equation for given Y and return vector of solutions
 		std::vector<double>	Solve(double forY = 0.0);
 	};
 
-}
\ No newline at end of file
+}
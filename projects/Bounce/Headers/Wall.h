@@ -1,6 +1,7 @@
 #pragma once
 
-#include "CoreModifiable.h"
+#include <math.h>
+
 namespace Kigs
 {
 	// a Wall is defined by a position and normal
@@ -8,23 +9,36 @@ namespace Kigs
 	{
 	protected:
 
-		v2f	mPos;
-		v2f	mNormal;
+		float	mPosX;
+		float	mPosY;
+		float	mNormalX;
+		float	mNormalY;
 
 	public:
-		Wall(v2f pos, v2f normal) : mPos(pos), mNormal(normal)
+		Wall(float posX, float posY, float normalX, float normalY) : mPosX(posX), mPosY(posY)
 		{
-			mNormal = normalize(mNormal);// normalize normal vector 
+			// normalize normal vector 
+			float norm = sqrtf(normalX * normalX + normalY * normalY);
+			mNormalX = normalX / norm;
+			mNormalY = normalY / norm;
 		}
 
-		v2f	GetPos() const
+		float	GetPosX() const
+		{
+			return mPosX;
+		}
+		float	GetPosY() const
+		{
+			return mPosY;
+		}
+		float	GetNormalX() const
 		{
-			return mPos;
+			return mNormalX;
 		}
-		v2f	GetNormal() const
+		float	GetNormalY() const
 		{
-			return mNormal;
+			return mNormalY;
 		}
 
 	};
-}
\ No newline at end of file
+}
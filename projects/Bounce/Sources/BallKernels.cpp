@@ -0,0 +1,263 @@
+#include "BallKernels.h"
+#include "BounceSIMD.h"
+#include "Equation2.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace Kigs;
+
+typedef void (*collisionTimesFunction)(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit);
+
+// ball i position at time, broadcasted to all lanes
+struct ballAtTime
+{
+	double	mPosX;
+	double	mPosY;
+	double	mSpeedX;
+	double	mSpeedY;
+	double	mRadius;
+};
+
+inline ballAtTime	getBallAtTime(const BallStore& balls, int i, double time)
+{
+	return { balls.GetPosX(i, time), balls.GetPosY(i, time), balls.mSpeedX[i], balls.mSpeedY[i], balls.mRadius[i] };
+}
+
+// equation of one pair : |DP + t DS|^2 = (r1 + r2)^2 <=> at^2 + bt + c = 0, t relative to time
+// SIMD kernels use the same operations in the same order, so all paths give the same times
+inline void	pairEquation(const BallStore& balls, const ballAtTime& ball, int j, double time, double& a, double& b, double& c)
+{
+	double dtj = time - balls.mResetTime[j];
+	double DPx = ball.mPosX - (balls.mPosX[j] + dtj * balls.mSpeedX[j]);
+	double DPy = ball.mPosY - (balls.mPosY[j] + dtj * balls.mSpeedY[j]);
+	double DSx = ball.mSpeedX - balls.mSpeedX[j];
+	double DSy = ball.mSpeedY - balls.mSpeedY[j];
+	double contact = ball.mRadius + balls.mRadius[j];
+
+	a = DSx * DSx + DSy * DSy;
+	b = 2.0 * (DSx * DPx + DSy * DPy);
+	c = (DPx * DPx + DPy * DPy) - contact * contact;
+}
+
+inline void	setCollisionTimes(const Equation2Roots& roots, double time, double& enter, double& exit)
+{
+	// we need two results for a real intersection
+	if (roots.mCount == 2)
+	{
+		enter = time + std::min(roots.mRoots[0], roots.mRoots[1]);
+		exit = time + std::max(roots.mRoots[0], roots.mRoots[1]);
+	}
+	else
+	{
+		enter = -1.0;
+		exit = -1.0;
+	}
+}
+
+inline void	collisionTimeScalar(const BallStore& balls, const ballAtTime& ball, int j, double time, double& enter, double& exit)
+{
+	double a, b, c;
+	pairEquation(balls, ball, j, time, a, b, c);
+	Equation2Roots roots;
+	// same speed, distance never changes
+	if (a > 0.0)
+	{
+		roots = Equation2::SolveRoots(a, b, c);
+	}
+	setCollisionTimes(roots, time, enter, exit);
+}
+
+// balls are solved by batches of this size, on the stack
+const int ScalarBatchSize = 16;
+
+void	collisionTimesScalar(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit)
+{
+	ballAtTime ball = getBallAtTime(balls, i, time);
+	double a[ScalarBatchSize], b[ScalarBatchSize], c[ScalarBatchSize];
+	Equation2Roots roots[ScalarBatchSize];
+
+	for (int start = 0; start < count; start += ScalarBatchSize)
+	{
+		int batchCount = std::min(count - start, ScalarBatchSize);
+		for (int k = 0; k < batchCount; k++)
+		{
+			pairEquation(balls, ball, others[start + k], time, a[k], b[k], c[k]);
+			// same speed, distance never changes : solve t^2 + 1 = 0 instead (no root)
+			if (a[k] <= 0.0)
+			{
+				a[k] = 1.0;
+				b[k] = 0.0;
+				c[k] = 1.0;
+			}
+		}
+		Equation2::SolveRoots(a, b, c, batchCount, roots);
+		for (int k = 0; k < batchCount; k++)
+		{
+			setCollisionTimes(roots[k], time, enter[start + k], exit[start + k]);
+		}
+	}
+}
+
+#ifdef BOUNCE_X86_SIMD
+
+// no FMA : products are rounded as in the scalar path (the file is built with -ffp-contract=off, avx512f implies fma)
+
+BOUNCE_TARGET("avx2")
+void	collisionTimesAVX2(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit)
+{
+	ballAtTime ball = getBallAtTime(balls, i, time);
+	const __m256d t = _mm256_set1_pd(time);
+	const __m256d pix = _mm256_set1_pd(ball.mPosX);
+	const __m256d piy = _mm256_set1_pd(ball.mPosY);
+	const __m256d vix = _mm256_set1_pd(ball.mSpeedX);
+	const __m256d viy = _mm256_set1_pd(ball.mSpeedY);
+	const __m256d ri = _mm256_set1_pd(ball.mRadius);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d four = _mm256_set1_pd(4.0);
+	const __m256d minusHalf = _mm256_set1_pd(-0.5);
+	const __m256d noCollision = _mm256_set1_pd(-1.0);
+
+	int k = 0;
+	for (; k + 4 <= count; k += 4)
+	{
+		__m128i index = _mm_loadu_si128((const __m128i*)(others + k));
+		__m256d dtj = _mm256_sub_pd(t, _mm256_i32gather_pd(balls.mResetTime.data(), index, 8));
+		__m256d vjx = _mm256_cvtps_pd(_mm_i32gather_ps(balls.mSpeedX.data(), index, 4));
+		__m256d vjy = _mm256_cvtps_pd(_mm_i32gather_ps(balls.mSpeedY.data(), index, 4));
+		__m256d pjx = _mm256_add_pd(_mm256_cvtps_pd(_mm_i32gather_ps(balls.mPosX.data(), index, 4)), _mm256_mul_pd(dtj, vjx));
+		__m256d pjy = _mm256_add_pd(_mm256_cvtps_pd(_mm_i32gather_ps(balls.mPosY.data(), index, 4)), _mm256_mul_pd(dtj, vjy));
+		__m256d contact = _mm256_add_pd(ri, _mm256_cvtps_pd(_mm_i32gather_ps(balls.mRadius.data(), index, 4)));
+
+		__m256d DPx = _mm256_sub_pd(pix, pjx);
+		__m256d DPy = _mm256_sub_pd(piy, pjy);
+		__m256d DSx = _mm256_sub_pd(vix, vjx);
+		__m256d DSy = _mm256_sub_pd(viy, vjy);
+
+		__m256d a = _mm256_add_pd(_mm256_mul_pd(DSx, DSx), _mm256_mul_pd(DSy, DSy));
+		__m256d b = _mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(DSx, DPx), _mm256_mul_pd(DSy, DPy)));
+		__m256d c = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(DPx, DPx), _mm256_mul_pd(DPy, DPy)), _mm256_mul_pd(contact, contact));
+
+		// two roots if delta > 0, the largest one (in magnitude) first then the other one from the roots product (as Equation2)
+		__m256d delta = _mm256_sub_pd(_mm256_mul_pd(b, b), _mm256_mul_pd(_mm256_mul_pd(four, a), c));
+		__m256d valid = _mm256_and_pd(_mm256_cmp_pd(a, zero, _CMP_GT_OQ), _mm256_cmp_pd(delta, zero, _CMP_GT_OQ));
+		__m256d sqrtDelta = _mm256_sqrt_pd(_mm256_max_pd(delta, zero));
+		__m256d signedSqrt = _mm256_blendv_pd(sqrtDelta, _mm256_sub_pd(zero, sqrtDelta), _mm256_cmp_pd(b, zero, _CMP_LT_OQ));
+		__m256d q = _mm256_mul_pd(minusHalf, _mm256_add_pd(b, signedSqrt));
+		// invalid lanes can divide by 0, their result is replaced below
+		__m256d r1 = _mm256_div_pd(q, a);
+		__m256d r2 = _mm256_div_pd(c, _mm256_mul_pd(a, r1));
+
+		__m256d first = _mm256_add_pd(t, _mm256_min_pd(r1, r2));
+		__m256d last = _mm256_add_pd(t, _mm256_max_pd(r1, r2));
+		_mm256_storeu_pd(enter + k, _mm256_blendv_pd(noCollision, first, valid));
+		_mm256_storeu_pd(exit + k, _mm256_blendv_pd(noCollision, last, valid));
+	}
+
+	for (; k < count; k++)
+	{
+		collisionTimeScalar(balls, ball, others[k], time, enter[k], exit[k]);
+	}
+}
+
+BOUNCE_TARGET("avx512f")
+void	collisionTimesAVX512(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit)
+{
+	ballAtTime ball = getBallAtTime(balls, i, time);
+	const __m512d t = _mm512_set1_pd(time);
+	const __m512d pix = _mm512_set1_pd(ball.mPosX);
+	const __m512d piy = _mm512_set1_pd(ball.mPosY);
+	const __m512d vix = _mm512_set1_pd(ball.mSpeedX);
+	const __m512d viy = _mm512_set1_pd(ball.mSpeedY);
+	const __m512d ri = _mm512_set1_pd(ball.mRadius);
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d four = _mm512_set1_pd(4.0);
+	const __m512d minusHalf = _mm512_set1_pd(-0.5);
+	const __m512d noCollision = _mm512_set1_pd(-1.0);
+
+	int k = 0;
+	for (; k + 8 <= count; k += 8)
+	{
+		__m256i index = _mm256_loadu_si256((const __m256i*)(others + k));
+		__m512d dtj = _mm512_sub_pd(t, _mm512_i32gather_pd(index, balls.mResetTime.data(), 8));
+		__m512d vjx = _mm512_cvtps_pd(_mm256_i32gather_ps(balls.mSpeedX.data(), index, 4));
+		__m512d vjy = _mm512_cvtps_pd(_mm256_i32gather_ps(balls.mSpeedY.data(), index, 4));
+		__m512d pjx = _mm512_add_pd(_mm512_cvtps_pd(_mm256_i32gather_ps(balls.mPosX.data(), index, 4)), _mm512_mul_pd(dtj, vjx));
+		__m512d pjy = _mm512_add_pd(_mm512_cvtps_pd(_mm256_i32gather_ps(balls.mPosY.data(), index, 4)), _mm512_mul_pd(dtj, vjy));
+		__m512d contact = _mm512_add_pd(ri, _mm512_cvtps_pd(_mm256_i32gather_ps(balls.mRadius.data(), index, 4)));
+
+		__m512d DPx = _mm512_sub_pd(pix, pjx);
+		__m512d DPy = _mm512_sub_pd(piy, pjy);
+		__m512d DSx = _mm512_sub_pd(vix, vjx);
+		__m512d DSy = _mm512_sub_pd(viy, vjy);
+
+		__m512d a = _mm512_add_pd(_mm512_mul_pd(DSx, DSx), _mm512_mul_pd(DSy, DSy));
+		__m512d b = _mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(DSx, DPx), _mm512_mul_pd(DSy, DPy)));
+		__m512d c = _mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(DPx, DPx), _mm512_mul_pd(DPy, DPy)), _mm512_mul_pd(contact, contact));
+
+		__m512d delta = _mm512_sub_pd(_mm512_mul_pd(b, b), _mm512_mul_pd(_mm512_mul_pd(four, a), c));
+		__mmask8 valid = _mm512_cmp_pd_mask(a, zero, _CMP_GT_OQ) & _mm512_cmp_pd_mask(delta, zero, _CMP_GT_OQ);
+		__m512d sqrtDelta = _mm512_sqrt_pd(_mm512_max_pd(delta, zero));
+		__m512d signedSqrt = _mm512_mask_sub_pd(sqrtDelta, _mm512_cmp_pd_mask(b, zero, _CMP_LT_OQ), zero, sqrtDelta);
+		__m512d q = _mm512_mul_pd(minusHalf, _mm512_add_pd(b, signedSqrt));
+		__m512d r1 = _mm512_div_pd(q, a);
+		__m512d r2 = _mm512_div_pd(c, _mm512_mul_pd(a, r1));
+
+		__m512d first = _mm512_add_pd(t, _mm512_min_pd(r1, r2));
+		__m512d last = _mm512_add_pd(t, _mm512_max_pd(r1, r2));
+		_mm512_storeu_pd(enter + k, _mm512_mask_blend_pd(valid, noCollision, first));
+		_mm512_storeu_pd(exit + k, _mm512_mask_blend_pd(valid, noCollision, last));
+	}
+
+	for (; k < count; k++)
+	{
+		collisionTimeScalar(balls, ball, others[k], time, enter[k], exit[k]);
+	}
+}
+
+#endif // BOUNCE_X86_SIMD
+
+collisionTimesFunction	selectCollisionTimes()
+{
+#ifdef BOUNCE_X86_SIMD
+	if (BounceCPUSupports(true))
+	{
+		return collisionTimesAVX512;
+	}
+	if (BounceCPUSupports(false))
+	{
+		return collisionTimesAVX2;
+	}
+#endif
+	return collisionTimesScalar;
+}
+
+collisionTimesFunction	gCollisionTimes = selectCollisionTimes();
+
+void	Kigs::BallCollisionTimes(const BallStore& balls, int i, const int* others, int count, double time, double* enter, double* exit)
+{
+	gCollisionTimes(balls, i, others, count, time, enter, exit);
+}
+
+double	Kigs::BallWallCollisionTime(const BallStore& balls, int i, float wallX, float wallY, float normalX, float normalY, double time)
+{
+	// compute projected distance on wall normal, from the ball to the wall
+	double projectDist = (balls.GetPosX(i, time) - wallX) * normalX + (balls.GetPosY(i, time) - wallY) * normalY;
+	// compute projected speed on wall normal
+	double projectSpeed = balls.mSpeedX[i] * normalX + balls.mSpeedY[i] * normalY;
+
+	// if projectSpeed >= 0 then the wall is "behind" de ball direction
+	if (projectSpeed < 0.0)
+	{
+		// once projected on wall normal, we have d = projectDist + t projectSpeed
+		// we want to solve R = projectDist + t projectSpeed <=> t = (R - projectDist)/projectSpeed
+		double t = (balls.mRadius[i] - projectDist) / projectSpeed;
+		if (t >= 0.0) // if time is in the future, return it
+		{
+			return time + t;
+		}
+	}
+	// no collision found
+	return -1.0;
+}
@@ -0,0 +1,195 @@
+#include "BallLayer.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace Kigs;
+
+// band height in pixels
+const int BandSize = 16;
+
+// blend color (straight alpha) over pixel with the given coverage
+inline void	blendPixel(unsigned char* pixel, uint32_t color, float coverage)
+{
+	// most pixels are only covered by one ball
+	if (pixel[3] == 0)
+	{
+		pixel[0] = (unsigned char)color;
+		pixel[1] = (unsigned char)(color >> 8);
+		pixel[2] = (unsigned char)(color >> 16);
+		pixel[3] = (unsigned char)((float)(color >> 24) * coverage + 0.5f);
+		return;
+	}
+	float srcA = (float)(color >> 24) * (1.0f / 255.0f) * coverage;
+	float dstA = pixel[3] * (1.0f / 255.0f);
+	float outA = srcA + dstA * (1.0f - srcA);
+	if (outA <= 0.0f)
+	{
+		return;
+	}
+	float oneOnOutA = 1.0f / outA;
+	float srcW = srcA * oneOnOutA;
+	float dstW = dstA * (1.0f - srcA) * oneOnOutA;
+	for (int c = 0; c < 3; c++)
+	{
+		float src = (float)((color >> (c * 8)) & 0xFF);
+		pixel[c] = (unsigned char)(src * srcW + pixel[c] * dstW + 0.5f);
+	}
+	pixel[3] = (unsigned char)(outA * 255.0f + 0.5f);
+}
+
+// draw the rows [y0, y1[ of a disc of radius rx horizontally and ry vertically
+inline void	drawDiscRows(unsigned char* pixels, int sizeX, int y0, int y1, float cx, float cy, float rx, float ry, uint32_t color)
+{
+	// pixels inside the inner ellipse are fully covered, outside the outer one are not covered
+	float oneOnInnerX = 1.0f / std::max(rx - 0.5f, 1.0e-3f);
+	float oneOnInnerY = 1.0f / std::max(ry - 0.5f, 1.0e-3f);
+	float outerX = rx + 0.5f;
+	float oneOnOuterY = 1.0f / (ry + 0.5f);
+	float oneOnRx2 = 1.0f / (rx * rx);
+	float oneOnRy2 = 1.0f / (ry * ry);
+	bool hasInner = (rx > 0.5f) && (ry > 0.5f);
+
+	for (int y = y0; y < y1; y++)
+	{
+		float dy = (float)y + 0.5f - cy;
+		float v = dy * oneOnOuterY;
+		if (v * v >= 1.0f)
+		{
+			continue;
+		}
+		float halfWidth = outerX * sqrtf(1.0f - v * v);
+		int x0 = std::max((int)floorf(cx - halfWidth), 0);
+		int x1 = std::min((int)ceilf(cx + halfWidth), sizeX);
+		float innerV = dy * oneOnInnerY;
+		float innerV2 = innerV * innerV;
+		unsigned char* row = pixels + (size_t)y * sizeX * 4;
+		for (int x = x0; x < x1; x++)
+		{
+			float dx = (float)x + 0.5f - cx;
+			float innerU = dx * oneOnInnerX;
+			float coverage = 1.0f;
+			if (!hasInner || (innerU * innerU + innerV2 > 1.0f))
+			{
+				// signed distance to the ellipse f(x,y) = (dx/rx)^2 + (dy/ry)^2 - 1, approximated by f / |grad f|
+				// (exactly the distance to the circle edge near it when rx == ry)
+				float f = dx * dx * oneOnRx2 + dy * dy * oneOnRy2 - 1.0f;
+				float gx = 2.0f * dx * oneOnRx2;
+				float gy = 2.0f * dy * oneOnRy2;
+				float gradient2 = gx * gx + gy * gy;
+				float distance = (gradient2 > 0.0f) ? f / sqrtf(gradient2) : -1.0f;
+				coverage = std::min(0.5f - distance, 1.0f);
+				if (coverage <= 0.0f)
+				{
+					continue;
+				}
+			}
+			blendPixel(row + x * 4, color, coverage);
+		}
+	}
+}
+
+// FNV-1a hash of a value, to detect bands whose balls changed
+inline void	hashValue(uint32_t& hash, uint32_t value)
+{
+	for (int b = 0; b < 4; b++)
+	{
+		hash = (hash ^ ((value >> (b * 8)) & 0xFF)) * 16777619u;
+	}
+}
+
+inline uint32_t	floatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+void	BallLayer::Draw(unsigned char* pixels, int sizeX, int sizeY, const float* posX, const float* posY, const float* radiusX, const float* radiusY, const uint32_t* colors, int count)
+{
+	int bandCount = (sizeY + BandSize - 1) / BandSize;
+	if (bandCount <= 0)
+	{
+		return;
+	}
+
+	// another buffer or size : previous content is unknown, every band is cleared
+	if ((pixels != mPixels) || (sizeX != mSizeX) || (sizeY != mSizeY) || ((int)mBandSignature.size() != bandCount))
+	{
+		mPixels = pixels;
+		mSizeX = sizeX;
+		mSizeY = sizeY;
+		mBandSignature.assign(bandCount, 0);
+	}
+
+	// counting sort of the balls by band, a ball is in all the bands it covers (keeping array order in each band)
+	auto bandRange = [&](int i, int& first, int& last)
+	{
+		float r = radiusY[i] + 0.5f;
+		first = std::max((int)floorf((posY[i] - r) / BandSize), 0);
+		last = std::min((int)floorf((posY[i] + r) / BandSize), bandCount - 1);
+	};
+	mBandStart.assign(bandCount + 1, 0);
+	for (int i = 0; i < count; i++)
+	{
+		int first, last;
+		bandRange(i, first, last);
+		for (int b = first; b <= last; b++)
+		{
+			mBandStart[b + 1]++;
+		}
+	}
+	for (int b = 0; b < bandCount; b++)
+	{
+		mBandStart[b + 1] += mBandStart[b];
+	}
+	mBandBalls.resize(mBandStart[bandCount]);
+	mBandFill.assign(mBandStart.begin(), mBandStart.end() - 1);
+	for (int i = 0; i < count; i++)
+	{
+		int first, last;
+		bandRange(i, first, last);
+		for (int b = first; b <= last; b++)
+		{
+			mBandBalls[mBandFill[b]++] = i;
+		}
+	}
+
+	// bands don't share pixels : a band is cleared and drawn again only if its ball list or one of its balls changed
+	// (empty bands stay cleared, so static or sparse scenes only redraw around the balls)
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int b = 0; b < bandCount; b++)
+	{
+		// empty band hash is 1 so it differs from the 0 of unknown content
+		uint32_t signature = 1;
+		if (mBandStart[b + 1] > mBandStart[b])
+		{
+			signature = 2166136261u;
+			for (int k = mBandStart[b]; k < mBandStart[b + 1]; k++)
+			{
+				int i = mBandBalls[k];
+				hashValue(signature, (uint32_t)i);
+				hashValue(signature, floatBits(posX[i]));
+				hashValue(signature, floatBits(posY[i]));
+				hashValue(signature, floatBits(radiusX[i]));
+				hashValue(signature, floatBits(radiusY[i]));
+				hashValue(signature, colors[i]);
+			}
+			signature = std::max(signature, 2u);
+		}
+		if (signature == mBandSignature[b])
+		{
+			continue;
+		}
+		mBandSignature[b] = signature;
+
+		int y0 = b * BandSize;
+		int y1 = std::min(y0 + BandSize, sizeY);
+		memset(pixels + (size_t)y0 * sizeX * 4, 0, (size_t)(y1 - y0) * sizeX * 4);
+		for (int k = mBandStart[b]; k < mBandStart[b + 1]; k++)
+		{
+			int i = mBandBalls[k];
+			drawDiscRows(pixels, sizeX, std::max(y0, (int)floorf(posY[i] - radiusY[i] - 0.5f)), std::min(y1, (int)ceilf(posY[i] + radiusY[i] + 0.5f)), posX[i], posY[i], radiusX[i], radiusY[i], colors[i]);
+		}
+	}
+}
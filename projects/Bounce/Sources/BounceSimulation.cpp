@@ -0,0 +1,376 @@
+#include "BounceSimulation.h"
+#include "BallKernels.h"
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Kigs;
+
+inline int	maxThreadCount()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+inline int	currentThread()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+// collision time of ball i with search.mCandidates balls (in search.mEnter), -1 if they don't bounce after time
+void	BounceSimulation::getBallCollisionTimes(int i, double time, collisionSearch& search) const
+{
+	int count = (int)search.mCandidates.size();
+	search.mEnter.resize(count);
+	search.mExit.resize(count);
+	BallCollisionTimes(mBalls, i, search.mCandidates.data(), count, time, search.mEnter.data(), search.mExit.data());
+
+	for (int k = 0; k < count; k++)
+	{
+		int j = search.mCandidates[k];
+		double enter = search.mEnter[k];
+		double exit = search.mExit[k];
+
+		double midt = (enter + exit) * 0.5;
+
+		bool bounce = (midt >= time) && (enter > mPreviousTime); // if a collision was found and collision occurs after current time
+		if (bounce && (enter < time)) // need more tests
+		{
+			double collision_duration = (exit - enter);
+			float DSx = (float)((mBalls.mSpeedX[i] - mBalls.mSpeedX[j]) * collision_duration);
+			float DSy = (float)((mBalls.mSpeedY[i] - mBalls.mSpeedY[j]) * collision_duration);
+			float norm = sqrtf(DSx * DSx + DSy * DSy);
+			if ((norm < mBalls.mRadius[i]) && (norm < mBalls.mRadius[j])) // not a bounce, just already interpenetrating balls
+			{
+				bounce = false;
+			}
+		}
+		search.mEnter[k] = bounce ? enter : -1.0;
+	}
+}
+
+void	BounceSimulation::searchBallCollisions(int i, double time, collisionSearch& search) const
+{
+	getBallCollisionTimes(i, time, search);
+	for (int k = 0; k < (int)search.mCandidates.size(); k++)
+	{
+		if (search.mEnter[k] >= 0.0)
+		{
+			int b1 = std::min(i, search.mCandidates[k]);
+			int b2 = std::max(i, search.mCandidates[k]);
+			search.mCollisions.push_back({ search.mEnter[k], b1, b2, -1, mCollisionCounts[b1], mCollisionCounts[b2] }); // collision with two balls
+		}
+	}
+
+	// check collisions with walls
+	for (int w = 0; w < (int)mWalls.size(); w++)
+	{
+		const Wall& wall = mWalls[w];
+		double futureC = BallWallCollisionTime(mBalls, i, wall.GetPosX(), wall.GetPosY(), wall.GetNormalX(), wall.GetNormalY(), time);
+		if (futureC >= time) // if  a collision was found and collision occurs after current time
+		{
+			search.mCollisions.push_back({ futureC, i, -1, w, mCollisionCounts[i], 0 }); // collision with current ball and a wall
+		}
+	}
+}
+
+// ball bounds over the trajectory from time to the horizon
+CollisionBounds	BounceSimulation::getSweptBounds(int ball, double time) const
+{
+	float startX = (float)mBalls.GetPosX(ball, time);
+	float startY = (float)mBalls.GetPosY(ball, time);
+	float endX = (float)mBalls.GetPosX(ball, mHorizon);
+	float endY = (float)mBalls.GetPosY(ball, mHorizon);
+	float r = mBalls.mRadius[ball];
+
+	CollisionBounds bounds;
+	bounds.mMinX = std::min(startX, endX) - r;
+	bounds.mMinY = std::min(startY, endY) - r;
+	bounds.mMaxX = std::max(startX, endX) + r;
+	bounds.mMaxY = std::max(startY, endY) + r;
+	return bounds;
+}
+
+void	BounceSimulation::addCollision(const collisionStruct& collision)
+{
+	mFutureCollisions.push_back(collision);
+	std::push_heap(mFutureCollisions.begin(), mFutureCollisions.end(), std::greater<collisionStruct>());
+}
+
+// remove obsolete collisions from the heap top, return false if the heap is empty
+bool	BounceSimulation::popObsoleteCollisions()
+{
+	while (mFutureCollisions.size())
+	{
+		const collisionStruct& next = mFutureCollisions[0];
+		bool obsolete = (next.mCount1 != mCollisionCounts[next.mBall1]) || ((next.mBall2 >= 0) && (next.mCount2 != mCollisionCounts[next.mBall2]));
+		if (!obsolete)
+		{
+			return true;
+		}
+		std::pop_heap(mFutureCollisions.begin(), mFutureCollisions.end(), std::greater<collisionStruct>());
+		mFutureCollisions.pop_back();
+	}
+	return false;
+}
+
+// compute all possible collisions up to a new horizon
+// the horizon is the time an average ball needs to move by its diameter, so swept bounds stay about the ball size
+void	BounceSimulation::FindFutureCollisions(double time)
+{
+	mFutureCollisions.clear();
+	int ballCount = mBalls.Size();
+	mCollisionCounts.resize(ballCount, 0);
+
+	double radiusSum = 0.0;
+	double speedSum = 0.0;
+	for (int i = 0; i < ballCount; i++)
+	{
+		radiusSum += mBalls.mRadius[i];
+		speedSum += sqrt((double)mBalls.mSpeedX[i] * mBalls.mSpeedX[i] + (double)mBalls.mSpeedY[i] * mBalls.mSpeedY[i]);
+	}
+	double horizon = 1.0;
+	if (speedSum > 0.0)
+	{
+		horizon = std::min(2.0 * radiusSum / speedSum, 1.0);
+	}
+	mHorizon = time + horizon;
+
+	// grid covers all swept bounds, with cells about the size of the average bounds
+	std::vector<CollisionBounds> bounds(ballCount);
+	CollisionBounds area;
+	float extentSum = 0.0f;
+	for (int i = 0; i < ballCount; i++)
+	{
+		bounds[i] = getSweptBounds(i, time);
+		if (i == 0)
+		{
+			area = bounds[i];
+		}
+		area.mMinX = std::min(area.mMinX, bounds[i].mMinX);
+		area.mMinY = std::min(area.mMinY, bounds[i].mMinY);
+		area.mMaxX = std::max(area.mMaxX, bounds[i].mMaxX);
+		area.mMaxY = std::max(area.mMaxY, bounds[i].mMaxY);
+		extentSum += 0.5f * ((bounds[i].mMaxX - bounds[i].mMinX) + (bounds[i].mMaxY - bounds[i].mMinY));
+	}
+	mGrid.Reset(area, ballCount ? extentSum / ballCount : 1.0f, ballCount);
+	for (int i = 0; i < ballCount; i++)
+	{
+		mGrid.Insert(i, bounds[i]);
+	}
+
+	// each thread fills its own collision list, then they are concatenated in thread order.
+	// Collisions are all different for the heap order (time, balls and wall), so the pop order
+	// doesn't depend on the thread count or scheduling
+	int threadCount = maxThreadCount();
+	if ((int)mSearches.size() < threadCount)
+	{
+		mSearches.resize(threadCount);
+	}
+	std::vector<size_t> offsets(threadCount + 1, 0);
+
+	#pragma omp parallel num_threads(threadCount)
+	{
+		int thread = currentThread();
+		collisionSearch& search = mSearches[thread];
+		search.mCollisions.clear();
+
+		#pragma omp for schedule(dynamic, 64)
+		for (int i = 0; i < ballCount; i++) // for each ball
+		{
+			// check collision with the previous balls, so each pair is tested once
+			search.mCandidates.clear();
+			mGrid.QueryObject(i, [&](int j)
+				{
+					if (j < i)
+					{
+						search.mCandidates.push_back(j);
+					}
+				});
+			searchBallCollisions(i, time, search);
+		}
+
+		offsets[thread + 1] = search.mCollisions.size();
+		#pragma omp barrier
+		#pragma omp single
+		{
+			for (int t = 0; t < threadCount; t++)
+			{
+				offsets[t + 1] += offsets[t];
+			}
+			mFutureCollisions.resize(offsets[threadCount]);
+		}
+		std::copy(search.mCollisions.begin(), search.mCollisions.end(), mFutureCollisions.begin() + offsets[thread]);
+	}
+
+	std::make_heap(mFutureCollisions.begin(), mFutureCollisions.end(), std::greater<collisionStruct>());
+}
+
+// search future collisions of the given ball with current trajectories
+void	BounceSimulation::findBallCollisions(int ball, double time, const int* ignoreBalls, int ignoreCount)
+{
+	collisionSearch& search = mSearches[0];
+	search.mCandidates.clear();
+	search.mCollisions.clear();
+	mGrid.Query(getSweptBounds(ball, time), [&](int other)
+		{
+			if ((other != ball) && (std::find(ignoreBalls, ignoreBalls + ignoreCount, other) == ignoreBalls + ignoreCount))
+			{
+				search.mCandidates.push_back(other);
+			}
+		});
+	searchBallCollisions(ball, time, search);
+	for (const auto& collision : search.mCollisions)
+	{
+		addCollision(collision);
+	}
+}
+
+// test if collision occurs "before" currentTime
+bool	BounceSimulation::computeNewTrajectories(double currentTime)
+{
+	// collisions after the horizon are not all known : search them again when the horizon is reached
+	if (!popObsoleteCollisions() || (mFutureCollisions[0].mCollisionTime > mHorizon))
+	{
+		if (currentTime >= mHorizon)
+		{
+			FindFutureCollisions(mHorizon);
+			return true;
+		}
+		return false;
+	}
+
+	if (currentTime >= mFutureCollisions[0].mCollisionTime) // a collision occured
+	{
+		collisionStruct collision = mFutureCollisions[0];
+		std::pop_heap(mFutureCollisions.begin(), mFutureCollisions.end(), std::greater<collisionStruct>());
+		mFutureCollisions.pop_back();
+
+		double collisionTime = collision.mCollisionTime; // get collision time
+		int b1 = collision.mBall1;
+
+		if (collision.mWall >= 0) // collision with wall
+		{
+			const Wall& wall = mWalls[collision.mWall];
+
+			// set new initial pos of the ball as the collision pos, collisionTime become t0 for the ball
+			mBalls.MoveTo(b1, collisionTime);
+
+			// compute speed symetry according to wall
+			float speedX = mBalls.mSpeedX[b1];
+			float speedY = mBalls.mSpeedY[b1];
+			float wdot = speedX * wall.GetNormalX() + speedY * wall.GetNormalY();
+
+			// and set new speed
+			mBalls.SetSpeed(b1, speedX - 2.0f * wdot * wall.GetNormalX(), speedY - 2.0f * wdot * wall.GetNormalY());
+			mStats.mWallCollisions++;
+
+			// only this ball collisions changed
+			mCollisionCounts[collision.mBall1]++;
+			mGrid.Update(collision.mBall1, getSweptBounds(collision.mBall1, collisionTime));
+			findBallCollisions(collision.mBall1, collisionTime, nullptr, 0);
+		}
+		else // collision with other ball
+		{
+			int b2 = collision.mBall2;
+
+			// set new initial pos of the ball as the collision pos for each ball
+			mBalls.MoveTo(b1, collisionTime);
+			mBalls.MoveTo(b2, collisionTime);
+
+			// compute new speed for each ball
+			// according to formula :
+			//
+			//  newspeedA = speedA -   2mB    *   Dot ( speedA - speedB , posA - posB ) * (posA-posB)  
+			//                       -------      -------------------------------------
+			//                      (mA + mB)               || posA-posB || ^2 
+
+			// if DP is normalized posA-posB then formula become : 
+			//
+			//  newspeedA = speedA -   2mB    *   Dot ( speedA - speedB , DP ) * DP  
+			//                       -------      
+			//                      (mA + mB)      
+
+			float DPx = mBalls.mPosX[b2] - mBalls.mPosX[b1];
+			float DPy = mBalls.mPosY[b2] - mBalls.mPosY[b1];
+			float norm = sqrtf(DPx * DPx + DPy * DPy);
+			DPx /= norm;
+			DPy /= norm;
+
+			float sp1x = mBalls.mSpeedX[b1];
+			float sp1y = mBalls.mSpeedY[b1];
+			float sp2x = mBalls.mSpeedX[b2];
+			float sp2y = mBalls.mSpeedY[b2];
+			float m1 = mBalls.mMass[b1];
+			float m2 = mBalls.mMass[b2];
+
+			// Dot ( speedA - speedB , DP ), Dot ( speedB - speedA , DP ) is its opposite
+			float DSdot = (sp1x - sp2x) * DPx + (sp1y - sp2y) * DPy;
+			float k1 = (2.0f * m2 / (m1 + m2)) * DSdot;
+			float k2 = (2.0f * m1 / (m1 + m2)) * -DSdot;
+			mBalls.SetSpeed(b1, sp1x - k1 * DPx, sp1y - k1 * DPy);
+			mBalls.SetSpeed(b2, sp2x - k2 * DPx, sp2y - k2 * DPy);
+
+			// momentum m1 sp1 + m2 sp2 is kept, up to float rounding
+			double momentumX = (double)m1 * (mBalls.mSpeedX[b1] - sp1x) + (double)m2 * (mBalls.mSpeedX[b2] - sp2x);
+			double momentumY = (double)m1 * (mBalls.mSpeedY[b1] - sp1y) + (double)m2 * (mBalls.mSpeedY[b2] - sp2y);
+			double momentumNorm = m1 * sqrt((double)sp1x * sp1x + (double)sp1y * sp1y) + m2 * sqrt((double)sp2x * sp2x + (double)sp2y * sp2y);
+			if (momentumNorm > 0.0)
+			{
+				mStats.mMaxMomentumError = std::max(mStats.mMaxMomentumError, sqrt(momentumX * momentumX + momentumY * momentumY) / momentumNorm);
+			}
+			mStats.mBallCollisions++;
+
+			// only collisions of these two balls changed, their pair is searched once
+			mCollisionCounts[collision.mBall1]++;
+			mCollisionCounts[collision.mBall2]++;
+			mGrid.Update(collision.mBall1, getSweptBounds(collision.mBall1, collisionTime));
+			mGrid.Update(collision.mBall2, getSweptBounds(collision.mBall2, collisionTime));
+			findBallCollisions(collision.mBall1, collisionTime, nullptr, 0);
+			findBallCollisions(collision.mBall2, collisionTime, &collision.mBall1, 1);
+		}
+
+		// return true so we will try again to test collisions
+		return true;
+	}
+	// no collision occured
+	return false;
+}
+
+void	BounceSimulation::Update(double currentTime)
+{
+	// while collisions occurs between last simulation time and currentTime, compute new trajectories and check if other collision can occur with new trajectories
+	while (computeNewTrajectories(currentTime))
+	{
+
+	}
+
+	mPreviousTime = currentTime;
+}
+
+double	BounceSimulation::GetNextCollisionTime()
+{
+	// collisions after the horizon are not known yet
+	return popObsoleteCollisions() ? std::min(mFutureCollisions[0].mCollisionTime, mHorizon) : mHorizon;
+}
+
+void	BounceSimulation::Rebase(double currentTime)
+{
+	mPreviousTime -= currentTime;
+	for (int i = 0; i < mBalls.Size(); i++)
+	{
+		mBalls.MoveTo(i, currentTime);
+		mBalls.mResetTime[i] = 0.0;
+	}
+	FindFutureCollisions(0.0);
+}
@@ -0,0 +1,94 @@
+#include "CollisionGrid.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace Kigs;
+
+// the grid never has more cells than this count per object (cell size is increased instead)
+const int MaxCellsPerObject = 4;
+
+void	CollisionGrid::Reset(const CollisionBounds& area, float cellSize, int objectCount)
+{
+	float sizeX = std::max(area.mMaxX - area.mMinX, 1.0f);
+	float sizeY = std::max(area.mMaxY - area.mMinY, 1.0f);
+	cellSize = std::max(cellSize, 1.0f);
+
+	float maxCells = (float)std::max(objectCount * MaxCellsPerObject, 1);
+	if ((sizeX / cellSize) * (sizeY / cellSize) > maxCells)
+	{
+		cellSize = sqrtf(sizeX * sizeY / maxCells);
+	}
+
+	mOriginX = area.mMinX;
+	mOriginY = area.mMinY;
+	mOneOnCellSize = 1.0f / cellSize;
+	mCellCountX = std::max((int)ceilf(sizeX * mOneOnCellSize), 1);
+	mCellCountY = std::max((int)ceilf(sizeY * mOneOnCellSize), 1);
+
+	mCells.resize(mCellCountX * mCellCountY);
+	for (auto& cell : mCells)
+	{
+		cell.clear();
+	}
+
+	mBounds.resize(objectCount);
+	mRanges.assign(objectCount, { 0, 0, -1, -1 });
+	mQueryMarks.assign(objectCount, 0);
+	mQueryMark = 0;
+}
+
+CollisionGrid::cellRange	CollisionGrid::getCellRange(const CollisionBounds& bounds) const
+{
+	cellRange range;
+	range.mX0 = std::min(std::max((int)floorf((bounds.mMinX - mOriginX) * mOneOnCellSize), 0), mCellCountX - 1);
+	range.mY0 = std::min(std::max((int)floorf((bounds.mMinY - mOriginY) * mOneOnCellSize), 0), mCellCountY - 1);
+	range.mX1 = std::min(std::max((int)floorf((bounds.mMaxX - mOriginX) * mOneOnCellSize), 0), mCellCountX - 1);
+	range.mY1 = std::min(std::max((int)floorf((bounds.mMaxY - mOriginY) * mOneOnCellSize), 0), mCellCountY - 1);
+	return range;
+}
+
+unsigned int	CollisionGrid::nextQueryMark()
+{
+	mQueryMark++;
+	// on wrap around, old marks could match again
+	if (mQueryMark == 0)
+	{
+		std::fill(mQueryMarks.begin(), mQueryMarks.end(), 0);
+		mQueryMark = 1;
+	}
+	return mQueryMark;
+}
+
+void	CollisionGrid::Insert(int id, const CollisionBounds& bounds)
+{
+	cellRange range = getCellRange(bounds);
+	mBounds[id] = bounds;
+	mRanges[id] = range;
+	for (int y = range.mY0; y <= range.mY1; y++)
+	{
+		for (int x = range.mX0; x <= range.mX1; x++)
+		{
+			mCells[y * mCellCountX + x].push_back(id);
+		}
+	}
+}
+
+void	CollisionGrid::Remove(int id)
+{
+	const cellRange& range = mRanges[id];
+	for (int y = range.mY0; y <= range.mY1; y++)
+	{
+		for (int x = range.mX0; x <= range.mX1; x++)
+		{
+			// cell order doesn't matter, swap with last
+			std::vector<int>& cell = mCells[y * mCellCountX + x];
+			auto found = std::find(cell.begin(), cell.end(), id);
+			if (found != cell.end())
+			{
+				*found = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+	mRanges[id] = { 0, 0, -1, -1 };
+}
@@ -0,0 +1,337 @@
+// headless Mandelbrot benchmark : renders fixed zoom paths with the fractal code only (no kigs framework)
+// and prints results as JSON, so kernel changes can be compared between runs
+//
+// usage : MandelbrotBenchmark [--frames N] [--threads 1,4,...] [--resolutions 640x360,1920x1080] [--path name] [--mode full|subdivide] [--antialias N] [--equalize] [--distance]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "MandelbrotDraw.h"
+
+using namespace Kigs;
+
+// zoom goes geometrically from startZoom to endZoom around a fixed center
+struct ZoomPath
+{
+	const char*	name;
+	const char*	centerX;
+	const char*	centerY;
+	double		startZoom;
+	double		endZoom;
+	// use perturbation over DeepZoomThreshold, else direct iteration (double-double)
+	bool		perturbation;
+	// standard Mandelbrot set if not given
+	MandelbrotFormula	formula = MandelbrotFormula();
+};
+
+// centers are given as strings so deep paths keep their full precision
+const ZoomPath Paths[] =
+{
+	// float then double kernels, mostly escaping pixels
+	{ "shallow", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 10.0, 1.0e8, true },
+	// perturbation, seahorse valley
+	{ "deep", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 2.0e12, 1.0e18, true },
+	// same zoom with double-double kernels
+	{ "doubledouble", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 2.0e12, 1.0e18, false },
+	// main cardioid / period 2 bulb junction, most pixels never escape
+	{ "interior", "-0.75", "0.0", 4.0, 2.0e3, true },
+	// Misiurewicz point, filaments everywhere
+	{ "boundary", "-0.77568377", "0.13646737", 100.0, 5.0e4, true },
+	// z^3 + c kernels (no cardioid shortcut)
+	{ "multibrot3", "-0.6", "0.35", 100.0, 5.0e4, true, { false, 3, 0.0, 0.0 } },
+	// Julia set kernels, dendrite of c = -0.8 + 0.156i
+	{ "julia", "0.0", "0.0", 200.0, 1.0e5, true, { true, 2, -0.8, 0.156 } },
+};
+
+struct Resolution
+{
+	int	sizeX;
+	int	sizeY;
+};
+
+struct Result
+{
+	std::string	path;
+	int			sizeX;
+	int			sizeY;
+	int			threads;
+	int			frames;
+	double		pixelsPerSecond;
+	double		iterationsPerSecond;
+	double		frameMsMean;
+	double		frameMsP50;
+	double		frameMsP99;
+	// mean time per stage, mean thread imbalance (slowest thread / mean thread busy time) and inside pixel ratio
+	double		iterateMsMean;
+	double		colorizeMsMean;
+	double		antialiasMsMean;
+	double		imbalanceMean;
+	double		insideRatio;
+};
+
+static std::vector<int>	parseIntList(const char* arg)
+{
+	std::vector<int> result;
+	const char* current = arg;
+	while (*current)
+	{
+		result.push_back(atoi(current));
+		const char* comma = strchr(current, ',');
+		if (!comma)
+		{
+			break;
+		}
+		current = comma + 1;
+	}
+	return result;
+}
+
+static std::vector<Resolution>	parseResolutions(const char* arg)
+{
+	std::vector<Resolution> result;
+	const char* current = arg;
+	while (*current)
+	{
+		Resolution r = { 0,0 };
+		if (sscanf(current, "%dx%d", &r.sizeX, &r.sizeY) == 2)
+		{
+			result.push_back(r);
+		}
+		const char* comma = strchr(current, ',');
+		if (!comma)
+		{
+			break;
+		}
+		current = comma + 1;
+	}
+	return result;
+}
+
+// nearest rank percentile of sorted values
+static double	percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+	size_t rank = (size_t)ceil(p * sorted.size());
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static Result	runPath(const ZoomPath& path, const Resolution& resolution, int threads, int frames, MandelbrotDrawMode mode, int antialias, bool equalize, bool distanceEstimation)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+
+	FixedPoint centerX = FixedPoint::FromString(path.centerX);
+	FixedPoint centerY = FixedPoint::FromString(path.centerY);
+
+	MandelbrotFrameStats stats;
+	MandelbrotIterateSettings settings;
+	settings.mode = mode;
+	settings.formula = path.formula;
+	settings.stats = &stats;
+	settings.distanceEstimation = distanceEstimation;
+
+	MandelbrotIterationBuffer buffer;
+	ReferenceOrbit orbit;
+	MandelbrotPalette palette;
+	std::vector<unsigned char> pixels(resolution.sizeX * resolution.sizeY * 4);
+
+	std::vector<double> frameTimes;
+	double totalIterations = 0.0;
+	double totalTime = 0.0;
+	double iterateTime = 0.0;
+	double colorizeTime = 0.0;
+	double antialiasTime = 0.0;
+	double imbalance = 0.0;
+	double insidePixels = 0.0;
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		double t = (frames > 1) ? (double)frame / (double)(frames - 1) : 0.0;
+		double zoom = path.startZoom * pow(path.endZoom / path.startZoom, t);
+
+		auto start = std::chrono::steady_clock::now();
+		if (path.perturbation && (zoom > DeepZoomThreshold))
+		{
+			IterateMandelbrotDeep(buffer, resolution.sizeX, resolution.sizeY, centerX, centerY, zoom, orbit, settings);
+		}
+		else
+		{
+			IterateMandelbrot(buffer, resolution.sizeX, resolution.sizeY, centerX, centerY, zoom, settings);
+		}
+		auto colorizeStart = std::chrono::steady_clock::now();
+		palette.Update(buffer.iterationMax, nullptr, false, path.formula.power);
+		if (equalize)
+		{
+			palette.Equalize(buffer);
+		}
+		ColorizeMandelbrot(pixels.data(), buffer, palette);
+		auto colorizeEnd = std::chrono::steady_clock::now();
+		if (antialias > 0)
+		{
+			MandelbrotAntialiasSettings antialiasSettings;
+			antialiasSettings.samples = antialias;
+			AntialiasMandelbrot(pixels.data(), buffer, palette, &orbit, antialiasSettings);
+		}
+		auto end = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed = end - start;
+
+		frameTimes.push_back(elapsed.count() * 1000.0);
+		totalTime += elapsed.count();
+
+		// iteration count each pixel would need without cardioid / periodicity / subdivision shortcuts
+		totalIterations += (double)stats.iterations;
+		iterateTime += stats.iterateTime;
+		colorizeTime += std::chrono::duration<double, std::milli>(colorizeEnd - colorizeStart).count();
+		antialiasTime += std::chrono::duration<double, std::milli>(end - colorizeEnd).count();
+		imbalance += stats.imbalance;
+		insidePixels += stats.insidePixels;
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	Result result;
+	result.path = path.name;
+	result.sizeX = resolution.sizeX;
+	result.sizeY = resolution.sizeY;
+	result.threads = threads;
+	result.frames = frames;
+	result.pixelsPerSecond = (totalTime > 0.0) ? ((double)resolution.sizeX * resolution.sizeY * frames) / totalTime : 0.0;
+	result.iterationsPerSecond = (totalTime > 0.0) ? totalIterations / totalTime : 0.0;
+	result.frameMsMean = (frames > 0) ? (totalTime * 1000.0) / frames : 0.0;
+	result.frameMsP50 = percentile(frameTimes, 0.5);
+	result.frameMsP99 = percentile(frameTimes, 0.99);
+	result.iterateMsMean = iterateTime / frames;
+	result.colorizeMsMean = colorizeTime / frames;
+	result.antialiasMsMean = antialiasTime / frames;
+	result.imbalanceMean = imbalance / frames;
+	result.insideRatio = insidePixels / ((double)resolution.sizeX * resolution.sizeY * frames);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 30;
+	std::vector<int> threads;
+	std::vector<Resolution> resolutions = { { 640,360 }, { 1280,720 }, { 1920,1080 } };
+	std::string onlyPath;
+	MandelbrotDrawMode mode = MandelbrotDrawMode::Full;
+	int antialias = 0;
+	bool equalize = false;
+	bool distanceEstimation = false;
+
+#ifdef _OPENMP
+	int maxThreads = omp_get_max_threads();
+#else
+	int maxThreads = 1;
+#endif
+	threads.push_back(1);
+	if (maxThreads > 1)
+	{
+		threads.push_back(maxThreads);
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1) < argc;
+		if ((strcmp(argv[i], "--frames") == 0) && hasValue)
+		{
+			frames = std::max(1, atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--threads") == 0) && hasValue)
+		{
+			threads = parseIntList(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--resolutions") == 0) && hasValue)
+		{
+			resolutions = parseResolutions(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--path") == 0) && hasValue)
+		{
+			onlyPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--mode") == 0) && hasValue)
+		{
+			mode = (strcmp(argv[++i], "subdivide") == 0) ? MandelbrotDrawMode::Subdivide : MandelbrotDrawMode::Full;
+		}
+		else if ((strcmp(argv[i], "--antialias") == 0) && hasValue)
+		{
+			antialias = std::max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--equalize") == 0)
+		{
+			equalize = true;
+		}
+		else if (strcmp(argv[i], "--distance") == 0)
+		{
+			distanceEstimation = true;
+		}
+		else
+		{
+			fprintf(stderr, "usage : %s [--frames N] [--threads 1,4,...] [--resolutions 640x360,1920x1080] [--path shallow|deep|doubledouble|interior|boundary|multibrot3|julia] [--mode full|subdivide] [--antialias N] [--equalize] [--distance]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for (const ZoomPath& path : Paths)
+	{
+		if (!onlyPath.empty() && (onlyPath != path.name))
+		{
+			continue;
+		}
+		for (const Resolution& resolution : resolutions)
+		{
+			for (int threadCount : threads)
+			{
+				if (threadCount < 1)
+				{
+					continue;
+				}
+				fprintf(stderr, "%s %dx%d %d thread(s)...\n", path.name, resolution.sizeX, resolution.sizeY, threadCount);
+				results.push_back(runPath(path, resolution, threadCount, frames, mode, antialias, equalize, distanceEstimation));
+			}
+		}
+	}
+
+	printf("{\n");
+	printf("  \"benchmark\": \"Mandelbrot\",\n");
+	printf("  \"mode\": \"%s\",\n", (mode == MandelbrotDrawMode::Subdivide) ? "subdivide" : "full");
+	printf("  \"frames\": %d,\n", frames);
+	printf("  \"antialias\": %d,\n", antialias);
+	printf("  \"equalize\": %s,\n", equalize ? "true" : "false");
+	printf("  \"distance\": %s,\n", distanceEstimation ? "true" : "false");
+	printf("  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		printf("    { \"path\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, \"frames\": %d, "
+			"\"pixels_per_second\": %.0f, \"iterations_per_second\": %.0f, "
+			"\"frame_ms_mean\": %.3f, \"frame_ms_p50\": %.3f, \"frame_ms_p99\": %.3f, "
+			"\"iterate_ms_mean\": %.3f, \"colorize_ms_mean\": %.3f, \"antialias_ms_mean\": %.3f, "
+			"\"thread_imbalance\": %.3f, \"inside_ratio\": %.4f }%s\n",
+			r.path.c_str(), r.sizeX, r.sizeY, r.threads, r.frames,
+			r.pixelsPerSecond, r.iterationsPerSecond,
+			r.frameMsMean, r.frameMsP50, r.frameMsP99,
+			r.iterateMsMean, r.colorizeMsMean, r.antialiasMsMean,
+			r.imbalanceMean, r.insideRatio, (i + 1 < results.size()) ? "," : "");
+	}
+	printf("  ]\n");
+	printf("}\n");
+	return 0;
+}
@@ -0,0 +1,520 @@
+// headless Mandelbrot animation : renders a video frame sequence along a keyframe path with the fractal code only
+// (no kigs framework), to numbered PNG / raw RGB files or as raw RGB frames on a pipe
+// (for example : ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1080 -r 60 -i - zoom.mp4).
+//
+// Keyframes give frame index, center, zoom and rotation (radians, as the application RotationAngle).
+// Between keyframes zoom is interpolated geometrically, rotation linearly, and the center so that the point zoomed to
+// moves at constant speed on screen.
+// Several frames are rendered at once, one per worker : worker w renders frames w, w + workers, w + 2 * workers...
+// and reuses its previous frame (reprojection) and its reference orbit (when the center did not move).
+// In the float tier, iteration max changes with zoom and the whole frame would be computed again anyway :
+// the previous frame is only reused when iteration max is unchanged.
+//
+// usage : MandelbrotAnimation --size 1920x1080 (--keyframes file | --keyframe frame x y zoom rotation ...) [--frames N]
+//                             [--workers N] [--format png|raw] [--smooth] [--mode full|subdivide] [--no-perturbation]
+//                             [--power N] [--julia cx cy] [--no-reuse] [--output frame_%05d.png|-]
+// keyframes file : one "frame x y zoom rotation" line per keyframe, lines starting with # are ignored
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+#include "MandelbrotDraw.h"
+#include "MandelbrotImageWriter.h"
+
+using namespace Kigs;
+
+struct Keyframe
+{
+	int			frame = 0;
+	FixedPoint	centerX;
+	FixedPoint	centerY;
+	double		zoom = 0.0;
+	double		rotation = 0.0;
+};
+
+struct FrameView
+{
+	FixedPoint	centerX;
+	FixedPoint	centerY;
+	double		zoom = 0.0;
+	double		rotation = 0.0;
+};
+
+// output file name pattern must hold exactly one frame index conversion (%d or %0Nd) and no other %,
+// as it is used as a printf format
+static bool	validOutputPattern(const std::string& pattern)
+{
+	int conversions = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		if (pattern[i] != '%')
+		{
+			continue;
+		}
+		// optional 0 flag then up to 2 width digits
+		size_t j = i + 1;
+		if ((j < pattern.size()) && (pattern[j] == '0'))
+		{
+			j++;
+		}
+		size_t widthStart = j;
+		while ((j < pattern.size()) && (pattern[j] >= '0') && (pattern[j] <= '9'))
+		{
+			j++;
+		}
+		if ((j >= pattern.size()) || (pattern[j] != 'd') || (j - widthStart > 2))
+		{
+			return false;
+		}
+		conversions++;
+		i = j;
+	}
+	return conversions == 1;
+}
+
+static bool	parseKeyframe(const char* frame, const char* x, const char* y, const char* zoom, const char* rotation, Keyframe& keyframe)
+{
+	keyframe.frame = atoi(frame);
+	keyframe.centerX = FixedPoint::FromString(x);
+	keyframe.centerY = FixedPoint::FromString(y);
+	keyframe.zoom = atof(zoom);
+	keyframe.rotation = atof(rotation);
+	return (keyframe.frame >= 0) && (keyframe.zoom > 0.0);
+}
+
+static bool	readKeyframes(const char* fileName, std::vector<Keyframe>& keyframes)
+{
+	FILE* file = fopen(fileName, "r");
+	if (!file)
+	{
+		return false;
+	}
+	bool ok = true;
+	char line[1024];
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		// centers are kept as strings, FixedPoint has more digits than a double
+		char frame[64], x[256], y[256], zoom[64], rotation[64];
+		int count = sscanf(line, "%63s %255s %255s %63s %63s", frame, x, y, zoom, rotation);
+		if ((count <= 0) || (frame[0] == '#'))
+		{
+			continue;
+		}
+		if (count == 4)
+		{
+			strcpy(rotation, "0");
+		}
+		Keyframe keyframe;
+		ok = (count >= 4) && parseKeyframe(frame, x, y, zoom, rotation, keyframe);
+		keyframes.push_back(keyframe);
+	}
+	fclose(file);
+	return ok;
+}
+
+// view of the given frame, keyframes are sorted by frame
+static FrameView	interpolateView(const std::vector<Keyframe>& keyframes, int frame)
+{
+	size_t next = 1;
+	while ((next < keyframes.size() - 1) && (keyframes[next].frame < frame))
+	{
+		next++;
+	}
+	const Keyframe& k0 = keyframes[next - 1];
+	const Keyframe& k1 = keyframes[std::min(next, keyframes.size() - 1)];
+
+	FrameView view;
+	int length = k1.frame - k0.frame;
+	double t = (length > 0) ? std::min(std::max((double)(frame - k0.frame) / length, 0.0), 1.0) : 0.0;
+	view.zoom = k0.zoom * pow(k1.zoom / k0.zoom, t);
+	view.rotation = k0.rotation + (k1.rotation - k0.rotation) * t;
+
+	// zooming in, the keyframe 1 center moves at constant speed on screen to the middle of the screen :
+	// its screen offset (C1 - C) * zoom is (C1 - C0) * zoom0 * (1 - t).
+	// Zooming out, the keyframe 0 center leaves the middle of the screen the same way
+	double u = (k1.zoom >= k0.zoom) ? 1.0 - (1.0 - t) * k0.zoom / view.zoom : t * k1.zoom / view.zoom;
+	if (u <= 0.0)
+	{
+		view.centerX = k0.centerX;
+		view.centerY = k0.centerY;
+	}
+	else if (u >= 1.0)
+	{
+		view.centerX = k1.centerX;
+		view.centerY = k1.centerY;
+	}
+	else
+	{
+		view.centerX = k0.centerX + (k1.centerX - k0.centerX) * FixedPoint(u);
+		view.centerY = k0.centerY + (k1.centerY - k0.centerY) * FixedPoint(u);
+	}
+	return view;
+}
+
+// RGBA pixels to RGB rows, rotated around the frame center with bilinear filtering.
+// The rendered frame covers the rotated view, its center pixel (sizeX / 2, sizeY / 2) is the view center
+static void	rotateFrame(const uint32_t* pixels, int sizeX, int sizeY, double rotation, unsigned char* rgb, int outSizeX, int outSizeY)
+{
+	float c = (float)cos(rotation);
+	float s = (float)sin(rotation);
+	for (int y = 0; y < outSizeY; y++)
+	{
+		unsigned char* out = rgb + (size_t)y * outSizeX * 3;
+		float dy = (float)(y - outSizeY / 2);
+		for (int x = 0; x < outSizeX; x++)
+		{
+			float dx = (float)(x - outSizeX / 2);
+			float sx = std::min(std::max((float)(sizeX / 2) + c * dx + s * dy, 0.0f), (float)(sizeX - 2));
+			float sy = std::min(std::max((float)(sizeY / 2) - s * dx + c * dy, 0.0f), (float)(sizeY - 2));
+			int ix = (int)sx;
+			int iy = (int)sy;
+			float fx = sx - ix;
+			float fy = sy - iy;
+			const uint32_t* p = pixels + iy * sizeX + ix;
+			for (int channel = 0; channel < 3; channel++)
+			{
+				int shift = channel * 8;
+				float c00 = (float)((p[0] >> shift) & 0xFF);
+				float c10 = (float)((p[1] >> shift) & 0xFF);
+				float c01 = (float)((p[sizeX] >> shift) & 0xFF);
+				float c11 = (float)((p[sizeX + 1] >> shift) & 0xFF);
+				float value = (c00 * (1.0f - fx) + c10 * fx) * (1.0f - fy) + (c01 * (1.0f - fx) + c11 * fx) * fy;
+				out[channel] = (unsigned char)(value + 0.5f);
+			}
+			out += 3;
+		}
+	}
+}
+
+static void	toRGB(const uint32_t* pixels, int count, unsigned char* rgb)
+{
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t color = pixels[i];
+		rgb[0] = (unsigned char)color;
+		rgb[1] = (unsigned char)(color >> 8);
+		rgb[2] = (unsigned char)(color >> 16);
+		rgb += 3;
+	}
+}
+
+static bool	writeImage(ImageWriter& writer, FILE* file, const unsigned char* rgb, int sizeX, int sizeY)
+{
+	bool ok = writer.Begin(file, sizeX, sizeY);
+	for (int y = 0; ok && (y < sizeY); y++)
+	{
+		ok = writer.WriteRow(rgb + (size_t)y * sizeX * 3);
+	}
+	return ok && writer.End();
+}
+
+// state of one worker : the previous frame and reference orbit it reuses
+struct AnimationWorker
+{
+	MandelbrotIterationBuffer	buffers[2];
+	int							current = 0;
+	ReferenceOrbit				orbit;
+	MandelbrotPalette			palette;
+	std::vector<uint32_t>		pixels;
+	std::vector<unsigned char>	rgb;
+};
+
+int main(int argc, char** argv)
+{
+	int sizeX = 1920;
+	int sizeY = 1080;
+	std::vector<Keyframe> keyframes;
+	int frameCount = 0;
+	int workers = 0;
+	bool png = true;
+	bool smooth = false;
+	bool perturbation = true;
+	bool reuse = true;
+	MandelbrotFormula formula;
+	MandelbrotDrawMode mode = MandelbrotDrawMode::Full;
+	std::string output = "frame_%05d.png";
+	bool outputSet = false;
+	bool argumentsOk = true;
+
+	for (int i = 1; argumentsOk && (i < argc); i++)
+	{
+		bool hasValue = (i + 1) < argc;
+		if ((strcmp(argv[i], "--size") == 0) && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &sizeX, &sizeY) != 2)
+			{
+				sizeX = sizeY = 0;
+			}
+		}
+		else if ((strcmp(argv[i], "--keyframes") == 0) && hasValue)
+		{
+			argumentsOk = readKeyframes(argv[++i], keyframes);
+		}
+		else if ((strcmp(argv[i], "--keyframe") == 0) && ((i + 5) < argc))
+		{
+			Keyframe keyframe;
+			argumentsOk = parseKeyframe(argv[i + 1], argv[i + 2], argv[i + 3], argv[i + 4], argv[i + 5], keyframe);
+			keyframes.push_back(keyframe);
+			i += 5;
+		}
+		else if ((strcmp(argv[i], "--frames") == 0) && hasValue)
+		{
+			frameCount = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--workers") == 0) && hasValue)
+		{
+			workers = std::max(1, atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--format") == 0) && hasValue)
+		{
+			png = (strcmp(argv[++i], "raw") != 0);
+		}
+		else if (strcmp(argv[i], "--smooth") == 0)
+		{
+			smooth = true;
+		}
+		else if ((strcmp(argv[i], "--mode") == 0) && hasValue)
+		{
+			mode = (strcmp(argv[++i], "subdivide") == 0) ? MandelbrotDrawMode::Subdivide : MandelbrotDrawMode::Full;
+		}
+		else if (strcmp(argv[i], "--no-perturbation") == 0)
+		{
+			perturbation = false;
+		}
+		else if (strcmp(argv[i], "--no-reuse") == 0)
+		{
+			reuse = false;
+		}
+		else if ((strcmp(argv[i], "--power") == 0) && hasValue)
+		{
+			formula.power = std::min(std::max(atoi(argv[++i]), 2), MandelbrotFormulaMaxPower);
+		}
+		else if ((strcmp(argv[i], "--julia") == 0) && ((i + 2) < argc))
+		{
+			formula.julia = true;
+			formula.juliaCx = atof(argv[++i]);
+			formula.juliaCy = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && hasValue)
+		{
+			output = argv[++i];
+			outputSet = true;
+		}
+		else
+		{
+			argumentsOk = false;
+		}
+	}
+
+	if (!argumentsOk || (sizeX <= 0) || (sizeY <= 0) || keyframes.empty())
+	{
+		fprintf(stderr, "usage : %s --size 1920x1080 (--keyframes file | --keyframe frame x y zoom rotation ...) [--frames N] [--workers N] [--format png|raw] [--smooth] [--mode full|subdivide] [--no-perturbation] [--power N] [--julia cx cy] [--no-reuse] [--output frame_%%05d.png|-]\n", argv[0]);
+		return 1;
+	}
+
+	std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.frame < b.frame; });
+	if (frameCount <= 0)
+	{
+		frameCount = keyframes.back().frame + 1;
+	}
+
+	// raw frames on stdout must be written in order, files can be written by each worker
+	bool pipe = (output == "-");
+	if (!png && !outputSet)
+	{
+		output = "frame_%05d.raw";
+	}
+	if (!pipe && !validOutputPattern(output))
+	{
+		fprintf(stderr, "invalid output pattern %s : it must hold one frame index conversion (%%d or %%0Nd) and no other %%\n", output.c_str());
+		return 1;
+	}
+	if (pipe)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+
+	// frames are rendered in parallel, each frame iteration gets the remaining threads
+#ifdef _OPENMP
+	int maxThreads = omp_get_max_threads();
+#else
+	int maxThreads = 1;
+#endif
+	if (workers == 0)
+	{
+		workers = maxThreads;
+	}
+	workers = std::min(workers, frameCount);
+	int frameThreads = std::max(1, maxThreads / workers);
+#ifdef _OPENMP
+	omp_set_max_active_levels(2);
+#endif
+
+	std::vector<AnimationWorker> workerStates(workers);
+	std::mutex outputMutex;
+	std::condition_variable outputCondition;
+	int nextOutputFrame = 0;
+	bool failed = false;
+	// reused and rendered pixels per tier : float, double, double-double and perturbation
+	const int TierCount = 4;
+	const char* tierNames[TierCount] = { "float", "double", "double-double", "perturbation" };
+	long long reusedPixels[TierCount] = { 0 };
+	long long totalPixels[TierCount] = { 0 };
+
+	auto start = std::chrono::steady_clock::now();
+
+	#pragma omp parallel num_threads(workers)
+	{
+#ifdef _OPENMP
+		int w = omp_get_thread_num();
+		omp_set_num_threads(frameThreads);
+#else
+		int w = 0;
+#endif
+		AnimationWorker& worker = workerStates[w];
+		long long workerReused[TierCount] = { 0 };
+		long long workerPixels[TierCount] = { 0 };
+
+		for (int frame = w; frame < frameCount; frame += workers)
+		{
+			FrameView view = interpolateView(keyframes, frame);
+
+			// rotated frames are rendered on their bounding box, then resampled
+			int renderSizeX = sizeX;
+			int renderSizeY = sizeY;
+			if (view.rotation != 0.0)
+			{
+				double c = fabs(cos(view.rotation));
+				double s = fabs(sin(view.rotation));
+				renderSizeX = (int)ceil(sizeX * c + sizeY * s) + 2;
+				renderSizeY = (int)ceil(sizeX * s + sizeY * c) + 2;
+			}
+
+			MandelbrotIterationBuffer& buffer = worker.buffers[worker.current];
+			const MandelbrotIterationBuffer& previous = worker.buffers[1 - worker.current];
+			worker.current = 1 - worker.current;
+
+			bool deep = perturbation && (view.zoom > DeepZoomThreshold);
+			int tier = deep ? 3 : (int)MandelbrotPrecisionForZoom(view.zoom);
+
+			MandelbrotIterateSettings settings;
+			settings.mode = mode;
+			settings.formula = formula;
+			settings.reprojectNeedsZ = smooth;
+			bool floatIterationMaxChanged = (tier == 0) && (previous.iterationMax != MandelbrotFloatIterationMax((float)view.zoom));
+			if (reuse && !floatIterationMaxChanged)
+			{
+				settings.previous = &previous;
+			}
+			if (deep)
+			{
+				IterateMandelbrotDeep(buffer, renderSizeX, renderSizeY, view.centerX, view.centerY, view.zoom, worker.orbit, settings);
+			}
+			else
+			{
+				IterateMandelbrot(buffer, renderSizeX, renderSizeY, view.centerX, view.centerY, view.zoom, settings);
+			}
+			workerReused[tier] += buffer.reusedPixels;
+			workerPixels[tier] += (long long)renderSizeX * renderSizeY;
+
+			worker.palette.Update(buffer.iterationMax, nullptr, smooth, formula.power);
+			worker.pixels.resize(buffer.iterations.size());
+			ColorizeMandelbrot((unsigned char*)worker.pixels.data(), buffer, worker.palette);
+
+			worker.rgb.resize((size_t)sizeX * sizeY * 3);
+			if (view.rotation != 0.0)
+			{
+				rotateFrame(worker.pixels.data(), renderSizeX, renderSizeY, view.rotation, worker.rgb.data(), sizeX, sizeY);
+			}
+			else
+			{
+				toRGB(worker.pixels.data(), sizeX * sizeY, worker.rgb.data());
+			}
+
+			if (pipe)
+			{
+				// wait for the previous frames (rendered by the other workers)
+				std::unique_lock<std::mutex> lock(outputMutex);
+				outputCondition.wait(lock, [&]() { return nextOutputFrame == frame; });
+				if (!failed)
+				{
+					failed = fwrite(worker.rgb.data(), 1, worker.rgb.size(), stdout) != worker.rgb.size();
+				}
+				nextOutputFrame++;
+				fprintf(stderr, "\r%d / %d frames", nextOutputFrame, frameCount);
+				outputCondition.notify_all();
+			}
+			else
+			{
+				char fileName[1024];
+				snprintf(fileName, sizeof(fileName), output.c_str(), frame);
+				FILE* file = fopen(fileName, "wb");
+				bool ok = false;
+				if (file)
+				{
+					PngWriter pngWriter;
+					RawWriter rawWriter;
+					ImageWriter* writer = png ? (ImageWriter*)&pngWriter : (ImageWriter*)&rawWriter;
+					ok = writeImage(*writer, file, worker.rgb.data(), sizeX, sizeY);
+					ok = (fclose(file) == 0) && ok;
+				}
+
+				std::lock_guard<std::mutex> lock(outputMutex);
+				if (!ok && !failed)
+				{
+					fprintf(stderr, "\nerror writing %s\n", fileName);
+				}
+				failed = failed || !ok;
+				nextOutputFrame++;
+				fprintf(stderr, "\r%d / %d frames", nextOutputFrame, frameCount);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(outputMutex);
+		for (int t = 0; t < TierCount; t++)
+		{
+			reusedPixels[t] += workerReused[t];
+			totalPixels[t] += workerPixels[t];
+		}
+	}
+	fprintf(stderr, "\n");
+
+	if (pipe)
+	{
+		failed = (fflush(stdout) != 0) || failed;
+	}
+	if (failed)
+	{
+		fprintf(stderr, "error writing frames to %s\n", pipe ? "stdout" : output.c_str());
+		return 1;
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	fprintf(stderr, "%d frames %dx%d in %.1f s : %.1f frames/min (%d workers x %d threads)\n",
+		frameCount, sizeX, sizeY, elapsed.count(), frameCount * 60.0 / elapsed.count(), workers, frameThreads);
+	for (int t = 0; t < TierCount; t++)
+	{
+		if (totalPixels[t] > 0)
+		{
+			fprintf(stderr, "%s tier : %.1f%% pixels reused from previous frames\n", tierNames[t], 100.0 * reusedPixels[t] / totalPixels[t]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,235 @@
+// headless Mandelbrot poster export : renders a view of any size tile by tile with the fractal code only (no kigs framework)
+// and streams each finished band of rows to a PNG or raw RGB file, so memory depends on tile size and image width,
+// never on image height. Supersampling iterates supersample x supersample samples per pixel and averages their colors.
+//
+// usage : MandelbrotExport --size 16384x16384 --center x y --zoom z [--supersample N] [--tile N] [--format png|raw]
+//                          [--smooth] [--distance] [--mode full|subdivide] [--no-perturbation] [--power N] [--julia cx cy] [--output file|-]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+#include "MandelbrotDraw.h"
+#include "MandelbrotImageWriter.h"
+
+using namespace Kigs;
+
+// average supersample x supersample blocks of the RGBA tile into its place in the RGB band
+static void	downsampleTile(const uint32_t* tile, int tileSampleSizeX, int tileSizeX, int tileSizeY, int supersample, unsigned char* band, int bandSizeX, int x)
+{
+	const int sampleCount = supersample * supersample;
+	for (int j = 0; j < tileSizeY; j++)
+	{
+		unsigned char* out = band + (j * bandSizeX + x) * 3;
+		for (int i = 0; i < tileSizeX; i++)
+		{
+			int r = 0, g = 0, b = 0;
+			for (int sj = 0; sj < supersample; sj++)
+			{
+				const uint32_t* samples = tile + (j * supersample + sj) * tileSampleSizeX + i * supersample;
+				for (int si = 0; si < supersample; si++)
+				{
+					uint32_t color = samples[si];
+					r += color & 0xFF;
+					g += (color >> 8) & 0xFF;
+					b += (color >> 16) & 0xFF;
+				}
+			}
+			out[0] = (unsigned char)((r + sampleCount / 2) / sampleCount);
+			out[1] = (unsigned char)((g + sampleCount / 2) / sampleCount);
+			out[2] = (unsigned char)((b + sampleCount / 2) / sampleCount);
+			out += 3;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int sizeX = 3840;
+	int sizeY = 2160;
+	std::string centerX = "-0.75";
+	std::string centerY = "0.0";
+	double zoom = 0.0;
+	int supersample = 1;
+	int tileSize = 256;
+	bool png = true;
+	bool smooth = false;
+	bool distanceEstimation = false;
+	bool perturbation = true;
+	MandelbrotFormula formula;
+	MandelbrotDrawMode mode = MandelbrotDrawMode::Full;
+	std::string output = "mandelbrot.png";
+	bool outputSet = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1) < argc;
+		if ((strcmp(argv[i], "--size") == 0) && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &sizeX, &sizeY) != 2)
+			{
+				sizeX = sizeY = 0;
+			}
+		}
+		else if ((strcmp(argv[i], "--center") == 0) && ((i + 2) < argc))
+		{
+			centerX = argv[++i];
+			centerY = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--zoom") == 0) && hasValue)
+		{
+			zoom = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--supersample") == 0) && hasValue)
+		{
+			supersample = std::max(1, atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--tile") == 0) && hasValue)
+		{
+			tileSize = std::max(16, atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--format") == 0) && hasValue)
+		{
+			png = (strcmp(argv[++i], "raw") != 0);
+		}
+		else if (strcmp(argv[i], "--smooth") == 0)
+		{
+			smooth = true;
+		}
+		else if (strcmp(argv[i], "--distance") == 0)
+		{
+			distanceEstimation = true;
+		}
+		else if ((strcmp(argv[i], "--mode") == 0) && hasValue)
+		{
+			mode = (strcmp(argv[++i], "subdivide") == 0) ? MandelbrotDrawMode::Subdivide : MandelbrotDrawMode::Full;
+		}
+		else if (strcmp(argv[i], "--no-perturbation") == 0)
+		{
+			perturbation = false;
+		}
+		else if ((strcmp(argv[i], "--power") == 0) && hasValue)
+		{
+			formula.power = std::min(std::max(atoi(argv[++i]), 2), MandelbrotFormulaMaxPower);
+		}
+		else if ((strcmp(argv[i], "--julia") == 0) && ((i + 2) < argc))
+		{
+			formula.julia = true;
+			formula.juliaCx = atof(argv[++i]);
+			formula.juliaCy = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && hasValue)
+		{
+			output = argv[++i];
+			outputSet = true;
+		}
+		else
+		{
+			sizeX = 0;
+			break;
+		}
+	}
+
+	if ((sizeX <= 0) || (sizeY <= 0))
+	{
+		fprintf(stderr, "usage : %s --size 16384x16384 --center x y --zoom z [--supersample N] [--tile N] [--format png|raw] [--smooth] [--distance] [--mode full|subdivide] [--no-perturbation] [--power N] [--julia cx cy] [--output file|-]\n", argv[0]);
+		return 1;
+	}
+	if (!png && !outputSet)
+	{
+		output = "mandelbrot.raw";
+	}
+
+	// default zoom shows the whole set
+	if (zoom <= 0.0)
+	{
+		zoom = std::min(sizeX, sizeY) / 3.0;
+	}
+
+	FILE* file;
+	if (output == "-")
+	{
+		file = stdout;
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+	else
+	{
+		file = fopen(output.c_str(), "wb");
+	}
+	if (!file)
+	{
+		fprintf(stderr, "can't open %s\n", output.c_str());
+		return 1;
+	}
+
+	// deep zoom test uses the sample spacing, as the benchmark and the application do for a frame
+	bool deep = perturbation && ((zoom * supersample) > DeepZoomThreshold);
+
+	auto start = std::chrono::steady_clock::now();
+
+	MandelbrotTiledRender render;
+	render.SetView(sizeX, sizeY, FixedPoint::FromString(centerX.c_str()), FixedPoint::FromString(centerY.c_str()), zoom, deep, supersample, formula);
+
+	MandelbrotPalette palette;
+	palette.Update(render.GetIterationMax(), nullptr, smooth, formula.power);
+
+	MandelbrotIterateSettings settings;
+	settings.mode = mode;
+	// boundary lines are drawn on samples, they get thinner with supersampling
+	settings.distanceEstimation = distanceEstimation;
+
+	// only one band of rows and one tile of samples are in memory
+	MandelbrotIterationBuffer buffer;
+	std::vector<uint32_t> tilePixels;
+	std::vector<unsigned char> band((size_t)sizeX * tileSize * 3);
+
+	PngWriter pngWriter;
+	RawWriter rawWriter;
+	ImageWriter* writer = png ? (ImageWriter*)&pngWriter : (ImageWriter*)&rawWriter;
+	bool ok = writer->Begin(file, sizeX, sizeY);
+
+	for (int y = 0; ok && (y < sizeY); y += tileSize)
+	{
+		int bandSizeY = std::min(tileSize, sizeY - y);
+		for (int x = 0; x < sizeX; x += tileSize)
+		{
+			int tileSizeX = std::min(tileSize, sizeX - x);
+			render.IterateTile(buffer, x * supersample, y * supersample, tileSizeX * supersample, bandSizeY * supersample, settings);
+			tilePixels.resize(buffer.iterations.size());
+			ColorizeMandelbrot((unsigned char*)tilePixels.data(), buffer, palette);
+			downsampleTile(tilePixels.data(), buffer.sizeX, tileSizeX, bandSizeY, supersample, band.data(), sizeX, x);
+		}
+		for (int j = 0; ok && (j < bandSizeY); j++)
+		{
+			ok = writer->WriteRow(band.data() + (size_t)j * sizeX * 3);
+		}
+		fprintf(stderr, "\r%d / %d rows", y + bandSizeY, sizeY);
+	}
+	fprintf(stderr, "\n");
+
+	ok = ok && writer->End();
+	if (file != stdout)
+	{
+		ok = (fclose(file) == 0) && ok;
+	}
+	if (!ok)
+	{
+		fprintf(stderr, "error writing %s\n", output.c_str());
+		return 1;
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	fprintf(stderr, "%dx%d (%dx%d samples per pixel, %s, iteration max %d) written to %s in %.1f s\n", sizeX, sizeY, supersample, supersample,
+		deep ? "perturbation" : "direct", render.GetIterationMax(), output.c_str(), elapsed.count());
+	return 0;
+}
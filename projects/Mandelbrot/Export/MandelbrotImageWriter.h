@@ -0,0 +1,289 @@
+#pragma once
+
+// streaming image writers shared by the headless tools (poster export, animation)
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#ifdef MANDELBROT_EXPORT_ZLIB
+#include <zlib.h>
+#endif
+
+// size of PNG IDAT chunks, and of uncompressed deflate blocks
+const int ImageChunkSize = 65535;
+
+// streaming RGB 8 bits image writer : rows are written in order, the whole image is never in memory
+class ImageWriter
+{
+public:
+
+	virtual ~ImageWriter()
+	{
+	}
+
+	virtual bool	Begin(FILE* file, int sizeX, int sizeY) = 0;
+	virtual bool	WriteRow(const unsigned char* rgb) = 0;
+	virtual bool	End() = 0;
+};
+
+// headerless interleaved RGB
+class RawWriter : public ImageWriter
+{
+public:
+
+	bool	Begin(FILE* file, int sizeX, int) override
+	{
+		mFile = file;
+		mRowSize = sizeX * 3;
+		return true;
+	}
+
+	bool	WriteRow(const unsigned char* rgb) override
+	{
+		return fwrite(rgb, 1, mRowSize, mFile) == mRowSize;
+	}
+
+	bool	End() override
+	{
+		return fflush(mFile) == 0;
+	}
+
+protected:
+	FILE*	mFile = nullptr;
+	size_t	mRowSize = 0;
+};
+
+// PNG, truecolor 8 bits, no row filter
+// rows are deflated with zlib when available, else stored in uncompressed deflate blocks (still a valid PNG)
+class PngWriter : public ImageWriter
+{
+public:
+
+	~PngWriter()
+	{
+#ifdef MANDELBROT_EXPORT_ZLIB
+		if (mStreamStarted)
+		{
+			deflateEnd(&mStream);
+		}
+#endif
+	}
+
+	bool	Begin(FILE* file, int sizeX, int sizeY) override
+	{
+		mFile = file;
+		mRowSize = sizeX * 3;
+		initCRCTable();
+
+		static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (fwrite(signature, 1, 8, mFile) != 8)
+		{
+			return false;
+		}
+
+		unsigned char header[13];
+		writeBigEndian(header, sizeX);
+		writeBigEndian(header + 4, sizeY);
+		header[8] = 8; // bits per channel
+		header[9] = 2; // truecolor
+		header[10] = 0; // deflate
+		header[11] = 0; // adaptive filtering (only filter 0 is used)
+		header[12] = 0; // no interlace
+		if (!writeChunk("IHDR", header, 13))
+		{
+			return false;
+		}
+
+		mRow.resize(mRowSize + 1);
+		mRow[0] = 0; // filter type none
+#ifdef MANDELBROT_EXPORT_ZLIB
+		memset(&mStream, 0, sizeof(mStream));
+		if (deflateInit(&mStream, Z_DEFAULT_COMPRESSION) != Z_OK)
+		{
+			return false;
+		}
+		mStreamStarted = true;
+		mChunk.resize(ImageChunkSize);
+		return true;
+#else
+		// zlib header : deflate, 32K window, no preset dictionary, fastest compression level
+		mChunk.clear();
+		mChunk.reserve(ImageChunkSize + 5);
+		mAdler = 1;
+		static const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+		return writeChunk("IDAT", zlibHeader, 2);
+#endif
+	}
+
+	bool	WriteRow(const unsigned char* rgb) override
+	{
+		memcpy(mRow.data() + 1, rgb, mRowSize);
+#ifdef MANDELBROT_EXPORT_ZLIB
+		return deflateData(mRow.data(), mRow.size(), Z_NO_FLUSH);
+#else
+		updateAdler(mRow.data(), mRow.size());
+		return storeData(mRow.data(), mRow.size());
+#endif
+	}
+
+	bool	End() override
+	{
+#ifdef MANDELBROT_EXPORT_ZLIB
+		if (!deflateData(nullptr, 0, Z_FINISH))
+		{
+			return false;
+		}
+#else
+		// flush last stored block, then an empty final block and the adler32 checksum
+		if (!mChunk.empty() && !flushStoredBlock())
+		{
+			return false;
+		}
+		unsigned char trailer[9] = { 0x01, 0x00, 0x00, 0xFF, 0xFF };
+		writeBigEndian(trailer + 5, mAdler);
+		if (!writeChunk("IDAT", trailer, 9))
+		{
+			return false;
+		}
+#endif
+		if (!writeChunk("IEND", nullptr, 0))
+		{
+			return false;
+		}
+		return fflush(mFile) == 0;
+	}
+
+protected:
+
+	static void	writeBigEndian(unsigned char* out, uint32_t value)
+	{
+		out[0] = (unsigned char)(value >> 24);
+		out[1] = (unsigned char)(value >> 16);
+		out[2] = (unsigned char)(value >> 8);
+		out[3] = (unsigned char)value;
+	}
+
+	void	initCRCTable()
+	{
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+			}
+			mCRCTable[n] = c;
+		}
+	}
+
+	uint32_t	updateCRC(uint32_t crc, const unsigned char* data, size_t size) const
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = mCRCTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	bool	writeChunk(const char* type, const unsigned char* data, size_t size)
+	{
+		unsigned char header[8];
+		writeBigEndian(header, (uint32_t)size);
+		memcpy(header + 4, type, 4);
+
+		uint32_t crc = updateCRC(0xFFFFFFFFu, header + 4, 4);
+		crc = updateCRC(crc, data, size) ^ 0xFFFFFFFFu;
+		unsigned char footer[4];
+		writeBigEndian(footer, crc);
+
+		return (fwrite(header, 1, 8, mFile) == 8) && ((size == 0) || (fwrite(data, 1, size, mFile) == size)) && (fwrite(footer, 1, 4, mFile) == 4);
+	}
+
+#ifdef MANDELBROT_EXPORT_ZLIB
+	// compress data, each time the output chunk is full it's written as an IDAT chunk
+	bool	deflateData(const unsigned char* data, size_t size, int flush)
+	{
+		mStream.next_in = (Bytef*)data;
+		mStream.avail_in = (uInt)size;
+		int result;
+		do
+		{
+			mStream.next_out = mChunk.data();
+			mStream.avail_out = (uInt)mChunk.size();
+			result = deflate(&mStream, flush);
+			if (result == Z_STREAM_ERROR)
+			{
+				return false;
+			}
+			size_t produced = mChunk.size() - mStream.avail_out;
+			if ((produced > 0) && !writeChunk("IDAT", mChunk.data(), produced))
+			{
+				return false;
+			}
+		} while ((mStream.avail_out == 0) || ((flush == Z_FINISH) && (result != Z_STREAM_END)));
+		return true;
+	}
+
+	z_stream					mStream;
+	bool						mStreamStarted = false;
+#else
+	void	updateAdler(const unsigned char* data, size_t size)
+	{
+		uint32_t a = mAdler & 0xFFFF;
+		uint32_t b = mAdler >> 16;
+		while (size > 0)
+		{
+			// sums can't overflow before 5552 bytes
+			size_t count = std::min(size, (size_t)5552);
+			for (size_t i = 0; i < count; i++)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += count;
+			size -= count;
+		}
+		mAdler = (b << 16) | a;
+	}
+
+	// append data to the current stored block, each full block is written as an IDAT chunk
+	bool	storeData(const unsigned char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			size_t count = std::min(size, (size_t)ImageChunkSize - mChunk.size());
+			mChunk.insert(mChunk.end(), data, data + count);
+			data += count;
+			size -= count;
+			if ((mChunk.size() == ImageChunkSize) && !flushStoredBlock())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// stored block header : not final, type 0, then length and its complement (little endian)
+	bool	flushStoredBlock()
+	{
+		uint16_t length = (uint16_t)mChunk.size();
+		unsigned char header[5] = { 0x00, (unsigned char)length, (unsigned char)(length >> 8), (unsigned char)~length, (unsigned char)(~length >> 8) };
+		mChunk.insert(mChunk.begin(), header, header + 5);
+		bool ok = writeChunk("IDAT", mChunk.data(), mChunk.size());
+		mChunk.clear();
+		return ok;
+	}
+
+	uint32_t					mAdler = 1;
+#endif
+
+	FILE*						mFile = nullptr;
+	size_t						mRowSize = 0;
+	uint32_t					mCRCTable[256];
+	std::vector<unsigned char>	mRow;
+	std::vector<unsigned char>	mChunk;
+};
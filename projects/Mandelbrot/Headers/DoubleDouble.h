@@ -0,0 +1,99 @@
+#pragma once
+
+#include "FixedPoint.h"
+
+namespace Kigs
+{
+	// unevaluated sum of two doubles hi + lo (|lo| <= half an ulp of hi) : about 106 bits of mantissa
+	// used for direct iteration when double precision is not enough and perturbation is disabled
+	// (only valid without -ffast-math / fp:fast : error free transformations rely on exact rounding)
+	class DoubleDouble
+	{
+	public:
+
+		DoubleDouble() : hi(0.0), lo(0.0)
+		{
+		}
+
+		DoubleDouble(double v) : hi(v), lo(0.0)
+		{
+		}
+
+		DoubleDouble(double h, double l) : hi(h), lo(l)
+		{
+		}
+
+		explicit DoubleDouble(const FixedPoint& v)
+		{
+			hi = v.ToDouble();
+			lo = (v - FixedPoint(hi)).ToDouble();
+		}
+
+		// a + b = s + e exactly
+		static DoubleDouble	TwoSum(double a, double b)
+		{
+			double s = a + b;
+			double bb = s - a;
+			double e = (a - (s - bb)) + (b - bb);
+			return DoubleDouble(s, e);
+		}
+
+		// same when |a| >= |b|
+		static DoubleDouble	QuickTwoSum(double a, double b)
+		{
+			double s = a + b;
+			double e = b - (s - a);
+			return DoubleDouble(s, e);
+		}
+
+		// a * b = p + e exactly (Dekker split, no FMA needed)
+		static DoubleDouble	TwoProduct(double a, double b)
+		{
+			const double splitter = 134217729.0; // 2^27 + 1
+			double t = splitter * a;
+			double aHi = t - (t - a);
+			double aLo = a - aHi;
+			t = splitter * b;
+			double bHi = t - (t - b);
+			double bLo = b - bHi;
+			double p = a * b;
+			double e = ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo;
+			return DoubleDouble(p, e);
+		}
+
+		DoubleDouble	operator+(const DoubleDouble& other) const
+		{
+			DoubleDouble s = TwoSum(hi, other.hi);
+			return QuickTwoSum(s.hi, s.lo + lo + other.lo);
+		}
+
+		DoubleDouble	operator-() const
+		{
+			return DoubleDouble(-hi, -lo);
+		}
+
+		DoubleDouble	operator-(const DoubleDouble& other) const
+		{
+			return *this + (-other);
+		}
+
+		DoubleDouble	operator*(const DoubleDouble& other) const
+		{
+			DoubleDouble p = TwoProduct(hi, other.hi);
+			return QuickTwoSum(p.hi, p.lo + (hi * other.lo + lo * other.hi));
+		}
+
+		bool	operator<(const DoubleDouble& other) const
+		{
+			return (hi < other.hi) || ((hi == other.hi) && (lo < other.lo));
+		}
+
+		double	ToDouble() const
+		{
+			return hi + lo;
+		}
+
+		double	hi;
+		double	lo;
+	};
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace Kigs
+{
+	// signed fixed point number : 32 bits integer part and 224 bits fractional part
+	// stored as a two's complement big integer in 32 bits limbs, most significant limb first
+	// used for deep zoom reference orbit where double precision is not enough
+	class FixedPoint
+	{
+	public:
+		static const int LimbCount = 8;
+
+		FixedPoint()
+		{
+			for (int i = 0; i < LimbCount; i++)
+			{
+				mLimbs[i] = 0;
+			}
+		}
+
+		FixedPoint(double v)
+		{
+			bool negative = (v < 0.0);
+			if (negative)
+			{
+				v = -v;
+			}
+			for (int i = 0; i < LimbCount; i++)
+			{
+				double limb = (double)(uint32_t)v;
+				mLimbs[i] = (uint32_t)limb;
+				v = (v - limb) * 4294967296.0;
+			}
+			if (negative)
+			{
+				negate();
+			}
+		}
+
+		// parse a decimal string like "-0.7436438870371587047521" without losing precision
+		static FixedPoint	FromString(const std::string& str)
+		{
+			FixedPoint result;
+			size_t pos = 0;
+			bool negative = false;
+			if ((pos < str.size()) && ((str[pos] == '-') || (str[pos] == '+')))
+			{
+				negative = (str[pos] == '-');
+				pos++;
+			}
+
+			uint32_t integerPart = 0;
+			while ((pos < str.size()) && (str[pos] >= '0') && (str[pos] <= '9'))
+			{
+				integerPart = integerPart * 10 + (str[pos] - '0');
+				pos++;
+			}
+
+			if ((pos < str.size()) && (str[pos] == '.'))
+			{
+				pos++;
+				size_t fracEnd = pos;
+				while ((fracEnd < str.size()) && (str[fracEnd] >= '0') && (str[fracEnd] <= '9'))
+				{
+					fracEnd++;
+				}
+				// horner scheme from the last digit : frac = (digit + frac) / 10
+				for (size_t i = fracEnd; i > pos; i--)
+				{
+					result.mLimbs[0] = (uint32_t)(str[i - 1] - '0');
+					result.divideSmall(10);
+				}
+			}
+			result.mLimbs[0] = integerPart;
+			if (negative)
+			{
+				result.negate();
+			}
+			return result;
+		}
+
+		double	ToDouble() const
+		{
+			FixedPoint absValue(*this);
+			bool negative = isNegative();
+			if (negative)
+			{
+				absValue.negate();
+			}
+			double result = 0.0;
+			double scale = 1.0;
+			for (int i = 0; i < LimbCount; i++)
+			{
+				result += (double)absValue.mLimbs[i] * scale;
+				scale *= 1.0 / 4294967296.0;
+			}
+			return negative ? -result : result;
+		}
+
+		bool	isNegative() const
+		{
+			return (mLimbs[0] & 0x80000000) != 0;
+		}
+
+		FixedPoint	operator+(const FixedPoint& other) const
+		{
+			FixedPoint result;
+			uint64_t carry = 0;
+			for (int i = LimbCount - 1; i >= 0; i--)
+			{
+				uint64_t sum = (uint64_t)mLimbs[i] + (uint64_t)other.mLimbs[i] + carry;
+				result.mLimbs[i] = (uint32_t)sum;
+				carry = sum >> 32;
+			}
+			return result;
+		}
+
+		FixedPoint	operator-() const
+		{
+			FixedPoint result(*this);
+			result.negate();
+			return result;
+		}
+
+		FixedPoint	operator-(const FixedPoint& other) const
+		{
+			return *this + (-other);
+		}
+
+		FixedPoint	operator*(const FixedPoint& other) const
+		{
+			// multiply magnitudes then fix sign
+			FixedPoint a(*this);
+			FixedPoint b(other);
+			bool negative = false;
+			if (a.isNegative())
+			{
+				a.negate();
+				negative = !negative;
+			}
+			if (b.isNegative())
+			{
+				b.negate();
+				negative = !negative;
+			}
+
+			// full product, limb k of the product has weight 2^(32*(2*(LimbCount-1)-k))
+			uint32_t product[2 * LimbCount] = { 0 };
+			for (int i = LimbCount - 1; i >= 0; i--)
+			{
+				uint64_t carry = 0;
+				for (int j = LimbCount - 1; j >= 0; j--)
+				{
+					uint64_t current = (uint64_t)a.mLimbs[i] * (uint64_t)b.mLimbs[j] + product[i + j + 1] + carry;
+					product[i + j + 1] = (uint32_t)current;
+					carry = current >> 32;
+				}
+				product[i] += (uint32_t)carry;
+			}
+
+			// keep limbs aligned with our fixed point (integer part overflow is ignored)
+			FixedPoint result;
+			for (int i = 0; i < LimbCount; i++)
+			{
+				result.mLimbs[i] = product[i + 1];
+			}
+			if (negative)
+			{
+				result.negate();
+			}
+			return result;
+		}
+
+		FixedPoint& operator+=(const FixedPoint& other)
+		{
+			*this = *this + other;
+			return *this;
+		}
+
+		FixedPoint& operator-=(const FixedPoint& other)
+		{
+			*this = *this - other;
+			return *this;
+		}
+
+		bool	operator==(const FixedPoint& other) const
+		{
+			for (int i = 0; i < LimbCount; i++)
+			{
+				if (mLimbs[i] != other.mLimbs[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool	operator!=(const FixedPoint& other) const
+		{
+			return !(*this == other);
+		}
+
+	protected:
+
+		// two's complement
+		void	negate()
+		{
+			uint64_t carry = 1;
+			for (int i = LimbCount - 1; i >= 0; i--)
+			{
+				uint64_t v = (uint64_t)(uint32_t)(~mLimbs[i]) + carry;
+				mLimbs[i] = (uint32_t)v;
+				carry = v >> 32;
+			}
+		}
+
+		// divide positive value by a small integer
+		void	divideSmall(uint32_t d)
+		{
+			uint64_t remainder = 0;
+			for (int i = 0; i < LimbCount; i++)
+			{
+				uint64_t current = (remainder << 32) | mLimbs[i];
+				mLimbs[i] = (uint32_t)(current / d);
+				remainder = current % d;
+			}
+		}
+
+		uint32_t	mLimbs[LimbCount];
+	};
+}
@@ -3,6 +3,7 @@
 #include "DataDrivenBaseApplication.h"
 #include "KigsBitmap.h"
 #include "UI/UIItem.h"
+#include "MandelbrotRenderThread.h"
 
 namespace Kigs
 {
@@ -30,7 +31,53 @@ namespace Kigs
 		SP<Draw::KigsBitmap>	mBitmap;
 		SP<Draw2D::UIItem>		mBitmapDisplay;
 
-		float			mZoomCoef;
+		double			mZoomCoef;
+		// high precision center, needed for deep zoom
+		FixedPoint		mZoomCenterX;
+		FixedPoint		mZoomCenterY;
+
+		// use perturbation when zoom is too deep for double precision (else double-double direct iteration is used)
+		maBool			mDeepZoom = BASE_ATTRIBUTE(DeepZoom, true);
+
+		// use Mariani-Silver subdivision, tiles with a uniform border are filled without computing the inside
+		// (Subdivide, TileSize and FrameCache are not used by progressive rendering)
+		maBool			mSubdivide = BASE_ATTRIBUTE(Subdivide, false);
+		maInt			mTileSize = BASE_ATTRIBUTE(TileSize, 64);
+
+		// reuse previous frame pixels over float precision zoom (float SIMD kernels are faster than reprojection)
+		maBool			mFrameCache = BASE_ATTRIBUTE(FrameCache, true);
+
+		// escape time formula z^Power + c : "Mandelbrot" (multibrot when Power > 2) or "Julia" (constant c)
+		maString		mFormula = BASE_ATTRIBUTE(Formula, "Mandelbrot");
+		maInt			mPower = BASE_ATTRIBUTE(Power, 2);
+		// Julia c moves on a circle of radius JuliaRadius around (JuliaCX, JuliaCY), at JuliaSpeed radians per second
+		maFloat			mJuliaCX = BASE_ATTRIBUTE(JuliaCX, -0.8f);
+		maFloat			mJuliaCY = BASE_ATTRIBUTE(JuliaCY, 0.156f);
+		maFloat			mJuliaRadius = BASE_ATTRIBUTE(JuliaRadius, 0.0f);
+		maFloat			mJuliaSpeed = BASE_ATTRIBUTE(JuliaSpeed, 0.0f);
+
+		// continuous coloring, only the colorization pass is affected
+		maBool			mSmoothColor = BASE_ATTRIBUTE(SmoothColor, false);
+		// histogram equalized colors, stable when iteration max grows with zoom
+		maBool			mEqualizeColor = BASE_ATTRIBUTE(EqualizeColor, false);
+		// distance estimation : anti-aliased boundary lines from a single sample per pixel (not with deep zoom)
+		maBool			mDistanceEstimation = BASE_ATTRIBUTE(DistanceEstimation, false);
+
+		// adaptive anti-aliasing : extra samples for pixels on color edges of the final frame (0 to disable)
+		maInt			mAntialias = BASE_ATTRIBUTE(Antialias, 0);
+
+		// progressive rendering : coarse pass first, then refined, an intermediate frame is shown every FrameBudget seconds
+		// it replaces the tiled renderer, so Subdivide, TileSize and FrameCache are ignored when it is set
+		maBool			mProgressive = BASE_ATTRIBUTE(Progressive, false);
+		maFloat			mFrameBudget = BASE_ATTRIBUTE(FrameBudget, 0.01f);
+
+		// frames are rendered in background, zoom only goes on once the current view is complete
+		MandelbrotRenderThread	mRenderThread;
+		bool					mRenderRequested = false;
+
+		// summary of the last shown frame stats (time per stage, thread imbalance, iterations, inside pixels), read only
+		maString		mFrameStats = BASE_ATTRIBUTE(FrameStats, "");
+		MandelbrotFrameStats	mLastFrameStats;
 
 		double			mStartTime = -1.0;
 		double			mRotationAngle = 0.0f;
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include <math.h>
+#include "FixedPoint.h"
+#include "MandelbrotPerturbation.h"
+#include "MandelbrotKernels.h"
+
+// direct iteration uses float up to this zoom (where float iteration max reaches its 255 cap,
+// so iteration max stays continuous), then double up to DoubleZoomLimit, then double-double
+// (over 1e8, rounding errors amplified by thousands of iterations change more than 1% of double precision pixels)
+const double FloatZoomLimit = 65536.0;
+const double DoubleZoomLimit = 1.0e8;
+
+// over this zoom, double precision is not enough and deep zoom (perturbation) should be used :
+// with its SIMD delta kernels it runs as fast (AVX2, near 1e8) to 2x faster (AVX-512) than the SIMD double-double kernels
+// from 2e8 to 1e18 (measured at the benchmark centers), double-double is only used when perturbation is disabled
+const double DeepZoomThreshold = DoubleZoomLimit;
+
+inline MandelbrotPrecision	MandelbrotPrecisionForZoom(double zoomCoef)
+{
+	if (zoomCoef <= FloatZoomLimit)
+	{
+		return MandelbrotPrecision::Float;
+	}
+	return (zoomCoef <= DoubleZoomLimit) ? MandelbrotPrecision::Double : MandelbrotPrecision::DoubleDouble;
+}
+
+// float precision iteration max : grows with zoom up to its 255 cap at FloatZoomLimit
+inline int	MandelbrotFloatIterationMax(float zoomCoef)
+{
+	float iterationMax = sqrtf(zoomCoef);
+	return (iterationMax > 255.0f) ? 255 : (int)iterationMax;
+}
+
+// analytic inside test : main cardioid q (q + (x - 1/4)) < y^2 / 4 with q = (x - 1/4)^2 + y^2,
+// or period 2 bulb (x + 1)^2 + y^2 < 1/16
+template<typename T>
+inline bool	MandelbrotInsideCardioidOrBulb(T x, T y)
+{
+	T y2 = y * y;
+	T xq = x - (T)0.25;
+	T q = xq * xq + y2;
+	if ((q * (q + xq)) < ((T)0.25 * y2))
+	{
+		return true;
+	}
+	T x1 = x + (T)1.0;
+	return (x1 * x1 + y2) < (T)0.0625;
+}
+
+enum class MandelbrotDrawMode
+{
+	// compute every pixel
+	Full,
+	// Mariani-Silver recursive subdivision of tiles : tiles with a uniform border inside the set are filled
+	Subdivide
+};
+
+// first stage output : iteration count and last Z for each pixel, independent of coloring
+// it also keeps the frame mapping, so that it can be reprojected when drawing the next frame
+struct MandelbrotIterationBuffer
+{
+	int					sizeX = 0;
+	int					sizeY = 0;
+	int					iterationMax = 0;
+
+	std::vector<int>	iterations;
+	std::vector<float>	Zx;
+	std::vector<float>	Zy;
+	// distance estimation frames only (else empty) : distance of each escaped pixel to the set boundary, in pixels
+	// (see MandelbrotIterateLineDistance), 0 for inside pixels
+	std::vector<float>	distance;
+
+	// frame mapping : pixel (x,y) is at center + (startDCx + x * D, startDCy + y * D)
+	Kigs::FixedPoint	centerX;
+	Kigs::FixedPoint	centerY;
+	double				startDCx = 0.0;
+	double				startDCy = 0.0;
+	double				D = 0.0;
+	bool				valid = false;
+
+	// how pixels were iterated, so more samples can be taken with the same mapping (anti-aliasing)
+	MandelbrotPrecision	precision = MandelbrotPrecision::Float;
+	bool				deep = false;
+	MandelbrotFormula	formula;
+
+	// count of pixels reused from previous frame, and average iteration count
+	int					reusedPixels = 0;
+	int					averageIteration = 0;
+	// count of consecutive reprojected frames up to this one, selects the rows computed again
+	int					reprojectedFrames = 0;
+
+	void	Resize(int sx, int sy)
+	{
+		sizeX = sx;
+		sizeY = sy;
+		iterations.resize(sx * sy);
+		Zx.resize(sx * sy);
+		Zy.resize(sx * sy);
+	}
+
+	void	Invalidate()
+	{
+		valid = false;
+	}
+};
+
+// frame instrumentation, filled on request to find why a frame is slow
+// (more inside pixels, higher iteration max, or unbalanced threads)
+struct MandelbrotFrameStats
+{
+	int					iterationMax = 0;
+	// sum of pixel iteration counts (inside pixels count iteration max), reused pixels included
+	long long			iterations = 0;
+	// escaped vs iteration max pixels, and pixels reused from previous frame
+	int					escapedPixels = 0;
+	int					insidePixels = 0;
+	int					reusedPixels = 0;
+
+	// busy time of each thread while iterating (ms), and imbalance : slowest thread busy time / mean busy time
+	std::vector<double>	threadBusyTime;
+	double				imbalance = 1.0;
+
+	// time per stage (ms), equalization is part of colorize
+	double				iterateTime = 0.0;
+	double				colorizeTime = 0.0;
+	double				antialiasTime = 0.0;
+
+	double	TotalTime() const
+	{
+		return iterateTime + colorizeTime + antialiasTime;
+	}
+
+	void	Reset()
+	{
+		*this = MandelbrotFrameStats();
+	}
+};
+
+struct MandelbrotIterateSettings
+{
+	MandelbrotDrawMode	mode = MandelbrotDrawMode::Full;
+	int					tileSize = 64;
+
+	// escape time formula, deep zoom falls back to direct iteration if it's not the standard Mandelbrot set
+	MandelbrotFormula	formula;
+
+	// previous frame, reprojected to avoid computing reliable pixels again (Full mode only)
+	const MandelbrotIterationBuffer*	previous = nullptr;
+	// when coloring only depends on iteration count, reprojected samples don't need close Z values
+	bool				reprojectNeedsZ = true;
+
+	// also estimate each pixel distance to the set boundary (larger escape radius, so iteration counts differ a bit) :
+	// colorization draws anti-aliased boundary lines, and subdivision stops splitting tiles proven to hold no set point.
+	// Ignored by deep zoom, frames are not reprojected
+	bool				distanceEstimation = false;
+
+	// when set (by another thread), remaining tiles are skipped and the frame is dropped
+	const std::atomic<bool>*	cancel = nullptr;
+
+	// when set, iteration stats of the frame are written there (colorize and antialias times are left untouched)
+	MandelbrotFrameStats*		stats = nullptr;
+};
+
+// palette texture size and tile size of its converted texels
+const int MandelbrotTextureSizeX = 256;
+const int MandelbrotTextureSizeY = 64;
+const int MandelbrotTextureTileShift = 3;
+
+// index of texel (x,y) (wrapped) in palette texels : close Z values of neighbour pixels read the same cache lines
+inline int	MandelbrotTextureIndex(int x, int y)
+{
+	const int tileMask = (1 << MandelbrotTextureTileShift) - 1;
+	const int tilesPerRow = MandelbrotTextureSizeX >> MandelbrotTextureTileShift;
+	x &= MandelbrotTextureSizeX - 1;
+	y &= MandelbrotTextureSizeY - 1;
+	int tile = (y >> MandelbrotTextureTileShift) * tilesPerRow + (x >> MandelbrotTextureTileShift);
+	return (tile << (2 * MandelbrotTextureTileShift)) + ((y & tileMask) << MandelbrotTextureTileShift) + (x & tileMask);
+}
+
+// second stage : iteration count to color lookup table, with optional texture modulated by last Z
+class MandelbrotPalette
+{
+public:
+
+	// rebuild tables only if something changed
+	// texture is 24 bits RGB 256x64 pixel data or null, it's converted when the pointer changes
+	// (so its content must not change while it's used)
+	// power is the formula power, smooth coloring continuous iteration count depends on it
+	void	Update(int iterationMax, const unsigned char* texture, bool smooth, int power = 2);
+
+	// histogram equalization : rebuild colors so that each part of the color gradient gets the same share
+	// of buffer escaped pixels, so colors don't band nor drift when iteration max grows with zoom.
+	// Call it for each frame after Update (which restores the iteration count colors), buffer iteration max must match
+	void	Equalize(const MandelbrotIterationBuffer& buffer);
+
+	int		GetIterationMax() const
+	{
+		return mIterationMax;
+	}
+
+	// RGBA colors (R in low byte), iterationMax + 1 entries, last one is the inside color
+	const uint32_t*	GetColors() const
+	{
+		return mColors.data();
+	}
+
+	// texture converted to 32 bits texels (R in low byte) stored by 8x8 texel tiles
+	// (see MandelbrotTextureIndex), or null
+	const uint32_t*	GetTexture() const
+	{
+		return mTexture ? mTexels.data() : nullptr;
+	}
+
+	bool	IsSmooth() const
+	{
+		return mSmooth;
+	}
+
+	// false if colors only depend on iteration count
+	bool	UsesZ() const
+	{
+		return (mTexture != nullptr) || mSmooth;
+	}
+
+	// color of a single sample, same result as ColorizeMandelbrot
+	uint32_t	GetColor(int iteration, float Zx, float Zy) const;
+
+protected:
+	std::vector<uint32_t>	mColors;
+	std::vector<uint32_t>	mTexels;
+	const unsigned char*	mTexture = nullptr;
+	int						mIterationMax = -1;
+	bool					mSmooth = false;
+	bool					mEqualized = false;
+	// 1 / log2(power)
+	float					mSmoothScale = 1.0f;
+};
+
+// first stage : fill buffer with iteration count and last Z, using direct iteration in the precision zoomCoef needs
+// (see MandelbrotPrecisionForZoom)
+// tiles are dispatched on all threads, return false if settings.cancel interrupted the frame (buffer is then invalid)
+bool	IterateMandelbrot(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, const MandelbrotIterateSettings& settings = MandelbrotIterateSettings());
+
+// first stage : fill buffer with iteration count and last Z, using perturbation around a high precision center
+bool	IterateMandelbrotDeep(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, const MandelbrotIterateSettings& settings = MandelbrotIterateSettings());
+// same, the reference orbit is kept in orbit (needed to anti-alias the frame, and reused by the next frame if the center did not change)
+bool	IterateMandelbrotDeep(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, Kigs::ReferenceOrbit& orbit, const MandelbrotIterateSettings& settings = MandelbrotIterateSettings());
+
+// progressive rendering : a new view is first iterated at 1/8 resolution (each sample fills its 8x8 block),
+// then refined at 1/4, 1/2 and full resolution during the following Update calls.
+// Each call stops when its time budget is spent, so the caller frame rate does not depend on the view cost
+class MandelbrotProgressiveRender
+{
+public:
+
+	// restart rendering if the view changed (deep is ignored if formula is not the standard Mandelbrot set,
+	// distanceEstimation is ignored by deep zoom)
+	void	SetView(int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, bool deep, const MandelbrotFormula& formula = MandelbrotFormula(), bool distanceEstimation = false);
+
+	// refine the current view during about budget seconds (the first pass is always finished)
+	// return true if the buffer was modified, stats (if set) get the iteration stats of this call
+	bool	Update(double budget, MandelbrotFrameStats* stats = nullptr);
+
+	bool	IsComplete() const
+	{
+		return mStarted && (mStep == 0);
+	}
+
+	// current pass resolution step (8, 4, 2, 1), 0 when complete
+	int		GetStep() const
+	{
+		return mStep;
+	}
+
+	const MandelbrotIterationBuffer&	GetBuffer() const
+	{
+		return mBuffer;
+	}
+
+	// reference orbit of a deep view, null otherwise
+	const Kigs::ReferenceOrbit*	GetOrbit() const
+	{
+		return mDeep ? &mOrbit : nullptr;
+	}
+
+protected:
+	MandelbrotIterationBuffer	mBuffer;
+	Kigs::ReferenceOrbit		mOrbit;
+	double						mZoomCoef = 0.0;
+	bool						mDeep = false;
+	bool						mStarted = false;
+	int							mStep = 0;
+	int							mNextRow = 0;
+};
+
+// tiled rendering of images too large to be iterated at once (poster export) :
+// the view is set once for the whole image, then any tile of it can be iterated with the same pixel mapping,
+// so memory only depends on tile size. Deep zoom shares one reference orbit between all tiles.
+// With supersampling, the image is iterated at supersample x resolution but keeps the iteration max of the output zoom
+class MandelbrotTiledRender
+{
+public:
+
+	// deep is ignored if formula is not the standard Mandelbrot set
+	void	SetView(int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, bool deep, int supersample = 1, const MandelbrotFormula& formula = MandelbrotFormula());
+
+	// iterate the tile at (x,y) in supersampled pixels with the view formula (settings.formula is ignored),
+	// return false if settings.cancel interrupted it
+	bool	IterateTile(MandelbrotIterationBuffer& buffer, int x, int y, int tileSizeX, int tileSizeY, const MandelbrotIterateSettings& settings = MandelbrotIterateSettings()) const;
+
+	// supersampled image size
+	int		GetSampleSizeX() const
+	{
+		return mSampleSizeX;
+	}
+
+	int		GetSampleSizeY() const
+	{
+		return mSampleSizeY;
+	}
+
+	int		GetIterationMax() const
+	{
+		return mIterationMax;
+	}
+
+protected:
+	Kigs::ReferenceOrbit		mOrbit;
+	Kigs::FixedPoint			mCenterX;
+	Kigs::FixedPoint			mCenterY;
+	double						mSampleZoomCoef = 0.0;
+	double						mSampleOffset = 0.0;
+	int							mSampleSizeX = 0;
+	int							mSampleSizeY = 0;
+	int							mIterationMax = 0;
+	bool						mDeep = false;
+	MandelbrotFormula			mFormula;
+};
+
+// second stage : convert iteration buffer to RGBA pixelsdata, palette must be built for buffer iterationMax
+void	ColorizeMandelbrot(unsigned char* pixelsdata, const MandelbrotIterationBuffer& buffer, const MandelbrotPalette& palette);
+
+struct MandelbrotAntialiasSettings
+{
+	// extra jittered samples for each refined pixel (rounded down to a square : 1, 4, 9, 16...)
+	int		samples = 4;
+	// a pixel is refined when the sum of its RGB differences with one of its 4 neighbours is over this
+	int		threshold = 48;
+
+	const std::atomic<bool>*	cancel = nullptr;
+};
+
+// optional third stage : adaptive anti-aliasing of colorized pixels.
+// Only pixels on color edges get extra samples, taken on a jittered grid inside the pixel and averaged with it,
+// so the cost depends on the amount of edges instead of the resolution.
+// orbit must be the reference orbit of a deep buffer (ignored otherwise).
+// Distance estimation frames are left as they are, their boundary lines are already anti-aliased
+// return false if settings.cancel interrupted it (pixels are then partially refined)
+bool	AntialiasMandelbrot(unsigned char* pixelsdata, const MandelbrotIterationBuffer& buffer, const MandelbrotPalette& palette, const Kigs::ReferenceOrbit* orbit, const MandelbrotAntialiasSettings& settings = MandelbrotAntialiasSettings());
+
+// both stages at once, in RGBA pixelsdata, stats of the frame are written in stats if set
+void	DrawMandelbrot(unsigned char* pixelsdata, int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, const unsigned char* texture, MandelbrotDrawMode mode = MandelbrotDrawMode::Full, int tileSize = 64, MandelbrotFrameStats* stats = nullptr);
+void	DrawMandelbrotDeep(unsigned char* pixelsdata, int sizeX, int sizeY, const Kigs::FixedPoint& zoomCenterX, const Kigs::FixedPoint& zoomCenterY, double zoomCoef, const unsigned char* texture, MandelbrotDrawMode mode = MandelbrotDrawMode::Full, int tileSize = 64, MandelbrotFrameStats* stats = nullptr);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "DoubleDouble.h"
+
+// scalar type used by direct (non perturbation) iteration
+enum class MandelbrotPrecision
+{
+	Float,
+	Double,
+	DoubleDouble
+};
+
+// highest power of z supported by formulas
+const int MandelbrotFormulaMaxPower = 5;
+
+// escape time formula z -> z^power + c
+// Mandelbrot family (multibrot when power > 2) : c is the pixel and z starts at c
+// Julia family : c is constant and z starts at the pixel
+struct MandelbrotFormula
+{
+	bool	julia = false;
+	// 2 to MandelbrotFormulaMaxPower
+	int		power = 2;
+	double	juliaCx = 0.0;
+	double	juliaCy = 0.0;
+
+	// standard Mandelbrot set, the only one perturbation (deep zoom) supports
+	bool	IsMandelbrot() const
+	{
+		return !julia && (power == 2);
+	}
+
+	bool	operator==(const MandelbrotFormula& other) const
+	{
+		return (julia == other.julia) && (power == other.power) && (!julia || ((juliaCx == other.juliaCx) && (juliaCy == other.juliaCy)));
+	}
+
+	bool	operator!=(const MandelbrotFormula& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// iterate a line of pixels : pixel i is at (startCx + i * Dx, startCy + i * Dy)
+// Dy is 0 for a row and Dx is 0 for a column
+// iteration count and last Z are written for each pixel, orbits falling in an attracting cycle get iterationMax
+// (as points in the main cardioid or period 2 bulb of the standard Mandelbrot set).
+// T is float, double or Kigs::DoubleDouble. Each formula has its own kernels (power and family are template parameters),
+// the best SIMD kernel available is chosen once for each type and formula
+template<typename T>
+void	MandelbrotIterateLine(T startCx, T startCy, T Dx, T Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, const MandelbrotFormula& formula = MandelbrotFormula());
+
+// escape radius of distance estimation kernels : the estimate needs |Z| much larger than 2,
+// so their iteration counts are a few iterations higher than MandelbrotIterateLine ones
+const double MandelbrotDistanceEscapeRadius2 = 1.0e4;
+
+// same as MandelbrotIterateLine, also tracking the derivative dZ of each orbit (dZ/dC, or dZ/dZ0 for Julia)
+// to write distance : distance of each escaped pixel to the set boundary, in C units, estimated as |Z| ln|Z| / (2 |dZ|).
+// By Koebe 1/4 theorem it's a lower bound for the Mandelbrot family and connected Julia sets (only an estimate for others).
+// Inside pixels, and pixels whose dZ overflowed (float kernels near the boundary), get 0.
+// Float and double have SIMD kernels, double-double always uses the scalar kernel
+template<typename T>
+void	MandelbrotIterateLineDistance(T startCx, T startCy, T Dx, T Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance, const MandelbrotFormula& formula = MandelbrotFormula());
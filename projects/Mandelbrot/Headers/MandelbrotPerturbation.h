@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include "FixedPoint.h"
+
+namespace Kigs
+{
+	// perturbation theory deep zoom :
+	// one reference orbit is computed with high precision at the view center,
+	// then each pixel only iterates its (double precision) delta to the reference :
+	//
+	//  dz(n+1) = 2 Z(n) dz(n) + dz(n)^2 + dc
+	//
+	// the first iterations are skipped using series approximation :
+	//
+	//  dz(n) = A(n) dc + B(n) dc^2 + C(n) dc^3
+	//
+	// when the pixel orbit gets closer to 0 than its delta (or reaches the end of the reference)
+	// the delta is rebased on the start of the reference orbit, which avoids glitches without needing a second reference
+	class ReferenceOrbit
+	{
+	public:
+
+		// compute the reference orbit at the given center and the series approximation
+		// valid for all deltas with |dc| <= maxDelta.
+		// When the center did not change, the orbit is reused (and extended if iterationMax grew) :
+		// a zoom on a fixed center only computes the series approximation again
+		void	Compute(const FixedPoint& centerX, const FixedPoint& centerY, int iterationMax, double maxDelta);
+
+		// iterate a line of pixels : pixel i has dc = (startDCx + i * Dx, startDCy + i * Dy)
+		// outputs are the same as the float kernels (iteration count and last Z)
+		// pixels are iterated 8 or 4 at a time by AVX-512 or AVX2 kernels when the CPU has them
+		void	IterateLine(double startDCx, double startDCy, double Dx, double Dy, int count, int* iterations, float* Zx, float* Zy) const;
+
+		int		GetSkippedIterations() const
+		{
+			return mSkippedIterations;
+		}
+
+		int		GetLength() const
+		{
+			return (int)mZx.size();
+		}
+
+	protected:
+
+		// reference orbit Z(0) = 0, Z(1) = C ... stored as double
+		std::vector<double>	mZx;
+		std::vector<double>	mZy;
+
+		// high precision center and last orbit point, to extend the orbit of the same center
+		FixedPoint	mReferenceX;
+		FixedPoint	mReferenceY;
+		FixedPoint	mLastZx;
+		FixedPoint	mLastZy;
+		bool		mEscaped = false;
+
+		// series approximation coefficients at mSkippedIterations
+		double	mA[2] = { 0.0,0.0 };
+		double	mB[2] = { 0.0,0.0 };
+		double	mC[2] = { 0.0,0.0 };
+
+		int		mSkippedIterations = 0;
+		int		mIterationMax = 0;
+
+		// used by the cardioid / bulb test and periodicity tolerance
+		double	mCenterX = 0.0;
+		double	mCenterY = 0.0;
+		double	mMaxDelta = 0.0;
+	};
+}
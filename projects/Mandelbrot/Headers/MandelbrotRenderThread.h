@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include "MandelbrotDraw.h"
+
+// without threads (javascript build), frames are rendered step by step in GetFrame
+#if !defined(__EMSCRIPTEN__)
+#define MANDELBROT_RENDER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// everything needed to render one view
+struct MandelbrotView
+{
+	int					sizeX = 0;
+	int					sizeY = 0;
+	Kigs::FixedPoint	centerX;
+	Kigs::FixedPoint	centerY;
+	double				zoomCoef = 1.0;
+	// use perturbation (zoom should be over DeepZoomThreshold), standard Mandelbrot formula only
+	bool				deep = false;
+	MandelbrotFormula	formula;
+
+	MandelbrotDrawMode	mode = MandelbrotDrawMode::Full;
+	int					tileSize = 64;
+	// reuse previous frame (except at float precision)
+	bool				frameCache = true;
+
+	// coarse to fine rendering, a frame is published after each progressiveBudget seconds of work
+	// (mode, tileSize and frameCache only apply to the non progressive renderer)
+	bool				progressive = false;
+	double				progressiveBudget = 0.01;
+
+	// palette texture (24 bits RGB 256x64), must stay valid while the renderer runs
+	const unsigned char*	texture = nullptr;
+	bool				smooth = false;
+	// histogram equalized colors
+	bool				equalize = false;
+	// distance estimation : anti-aliased boundary lines (direct iteration only, ignored by deep views)
+	bool				distanceEstimation = false;
+
+	// adaptive anti-aliasing extra samples on color edges (0 : disabled), applied to the final frame of the view
+	int					antialias = 0;
+};
+
+// render views on a worker thread (rendering itself is parallelized with OpenMP) :
+// the worker fills a back buffer and swaps it with the front buffer once the frame is complete,
+// the caller only copies the front buffer and never waits on fractal computation
+class MandelbrotRenderThread
+{
+public:
+
+	MandelbrotRenderThread();
+	~MandelbrotRenderThread();
+
+	// render this view, replacing the previous request if its rendering has not started yet
+	// (a full frame being rendered for an older request is cancelled)
+	void	Request(const MandelbrotView& view);
+
+	// copy the last finished frame to pixelsdata (sizeX x sizeY RGBA pixels) if a new one is available and return true
+	// a frame of another size (rendered for an older view size) is dropped and false is returned
+	// complete is set if this frame is the final one for the last requested view, even if it was dropped
+	// if stats is set, it gets the stats of this frame (iteration stats of its last render step)
+	bool	GetFrame(unsigned char* pixelsdata, int sizeX, int sizeY, bool& complete, MandelbrotFrameStats* stats = nullptr);
+
+	// stop worker thread, pending request is dropped
+	void	Stop();
+
+protected:
+
+	// get the pending request if any, render the current view a step further then publish the frame
+	// return false if there's nothing to do
+	bool	workStep();
+
+	// render a step of view, return true when the view is finished
+	// cancelled is set if a newer request interrupted it, there's nothing to publish then
+	bool	renderStep(const MandelbrotView& view, bool restart, bool& cancelled);
+
+#ifdef MANDELBROT_RENDER_THREAD
+	void	workerLoop();
+#endif
+
+	// worker side
+	MandelbrotIterationBuffer		mIterationBuffers[2];
+	int								mCurrentBuffer = 0;
+	MandelbrotProgressiveRender		mProgressiveRender;
+	Kigs::ReferenceOrbit			mOrbit;
+	MandelbrotPalette				mPalette;
+	std::vector<unsigned char>		mBackPixels;
+	int								mBackSizeX = 0;
+	int								mBackSizeY = 0;
+	MandelbrotFrameStats			mBackStats;
+	MandelbrotView					mCurrentView;
+	unsigned int					mCurrentRequestID = 0;
+	bool							mWorking = false;
+
+	// shared state
+	MandelbrotView					mPendingView;
+	bool							mHasPending = false;
+	unsigned int					mRequestID = 0;
+	bool							mQuit = false;
+	// set by Request, reset when the worker takes the new request
+	std::atomic<bool>				mCancel{ false };
+
+	std::vector<unsigned char>		mFrontPixels;
+	int								mFrontSizeX = 0;
+	int								mFrontSizeY = 0;
+	MandelbrotFrameStats			mFrontStats;
+	bool							mFrameReady = false;
+	unsigned int					mFrameRequestID = 0;
+	bool							mFrameComplete = false;
+
+	// reader side : the front buffer is swapped with this one under the lock, then copied without it
+	std::vector<unsigned char>		mReadPixels;
+
+#ifdef MANDELBROT_RENDER_THREAD
+	std::mutex						mMutex;
+	std::condition_variable			mWakeUp;
+	std::thread						mThread;
+#endif
+};
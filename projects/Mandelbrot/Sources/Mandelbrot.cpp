@@ -2,12 +2,11 @@
 #include <FilePathManager.h>
 #include <NotificationCenter.h>
 #include "TinyImage.h"
+#include "MandelbrotRenderThread.h"
 
 using namespace Kigs;
 using namespace Kigs::Pict;
 
-extern void	DrawMandelbrot(unsigned char* pixelsdata, int sizeX, int sizeY, float zoomCenterX, float zoomCenterY, float zoomCoef,TinyImage* bmp);
-
 IMPLEMENT_CLASS_INFO(Mandelbrot);
 
 IMPLEMENT_CONSTRUCTOR(Mandelbrot)
@@ -29,7 +28,9 @@ void	Mandelbrot::ProtectedInit()
 	// Load AppInit, GlobalConfig then launch first sequence
 	DataDrivenBaseApplication::ProtectedInit();
 
-	mZoomCoef = 10.0f;
+	mZoomCoef = 10.0;
+	mZoomCenterX = FixedPoint::FromString("-0.743643887037158704752191506114774");
+	mZoomCenterY = FixedPoint::FromString("0.131825904205311970493132056385139");
 
 	//mImage =TinyImage::CreateImage("Anneau.png");
 	mImage = TinyImage::CreateImage("copper.png");
@@ -38,8 +39,6 @@ void	Mandelbrot::ProtectedInit()
 
 void	Mandelbrot::ProtectedUpdate()
 {
-
-	static int count_frame = 0;
 	DataDrivenBaseApplication::ProtectedUpdate();
 
 	if (mBitmap)
@@ -50,15 +49,57 @@ void	Mandelbrot::ProtectedUpdate()
 		}
 		v2f bitmapSize = mBitmap->getValue<v2f>("Size");
 
-		DrawMandelbrot(mBitmap->GetPixelBuffer(), (int)bitmapSize.x, (int)bitmapSize.y, -0.743643887037151, 0.13182590420533, mZoomCoef, mImage.get());
-		mZoomCoef *= 1.01;
-		count_frame++;
 		double totalTime = DataDrivenBaseApplication::GetApplicationTimer()->GetTime() - mStartTime;
-		if (count_frame == 100)
+
+		bool complete = false;
+		if (mRenderThread.GetFrame(mBitmap->GetPixelBuffer(), (int)bitmapSize.x, (int)bitmapSize.y, complete, &mLastFrameStats))
+		{
+			const MandelbrotFrameStats& stats = mLastFrameStats;
+			int pixelCount = std::max(stats.escapedPixels + stats.insidePixels, 1);
+			char text[256];
+			snprintf(text, sizeof(text), "frame %.1f ms (iterate %.1f, colorize %.1f, antialias %.1f) imbalance %.2f on %d threads, iteration max %d, %.3g iterations, %.1f%% inside, %.1f%% reused",
+				stats.TotalTime(), stats.iterateTime, stats.colorizeTime, stats.antialiasTime, stats.imbalance, (int)stats.threadBusyTime.size(),
+				stats.iterationMax, (double)stats.iterations, 100.0 * stats.insidePixels / pixelCount, 100.0 * stats.reusedPixels / pixelCount);
+			setValue("FrameStats", std::string(text));
+		}
+		if (complete)
+		{
+			mZoomCoef *= 1.01;
+			mRenderRequested = false;
+		}
+
+		if (!mRenderRequested)
 		{
-			
-			printf("time per frame = %f\n", (float)totalTime/100.0f);
-			count_frame = 0;
+			MandelbrotView view;
+			view.sizeX = (int)bitmapSize.x;
+			view.sizeY = (int)bitmapSize.y;
+			view.centerX = mZoomCenterX;
+			view.centerY = mZoomCenterY;
+			view.zoomCoef = mZoomCoef;
+			view.formula.julia = ((std::string)mFormula == "Julia");
+			view.formula.power = std::min(std::max((int)mPower, 2), MandelbrotFormulaMaxPower);
+			if (view.formula.julia)
+			{
+				float speed = mJuliaSpeed;
+				float radius = mJuliaRadius;
+				float juliaCX = mJuliaCX;
+				float juliaCY = mJuliaCY;
+				view.formula.juliaCx = juliaCX + radius * cos(speed * totalTime);
+				view.formula.juliaCy = juliaCY + radius * sin(speed * totalTime);
+			}
+			view.deep = mDeepZoom && (mZoomCoef > DeepZoomThreshold);
+			view.mode = mSubdivide ? MandelbrotDrawMode::Subdivide : MandelbrotDrawMode::Full;
+			view.tileSize = mTileSize;
+			view.frameCache = mFrameCache;
+			view.progressive = mProgressive;
+			view.progressiveBudget = mFrameBudget;
+			view.texture = mImage ? mImage->GetPixelData() : nullptr;
+			view.smooth = mSmoothColor;
+			view.equalize = mEqualizeColor;
+			view.distanceEstimation = mDistanceEstimation;
+			view.antialias = mAntialias;
+			mRenderThread.Request(view);
+			mRenderRequested = true;
 		}
 
 		mBitmapDisplay->setValue("RotationAngle", mRotationAngle);
@@ -68,6 +109,8 @@ void	Mandelbrot::ProtectedUpdate()
 
 void	Mandelbrot::ProtectedClose()
 {
+	// worker uses mImage
+	mRenderThread.Stop();
 	mBitmap = nullptr;
 	mBitmapDisplay = nullptr;
 	DataDrivenBaseApplication::ProtectedClose();
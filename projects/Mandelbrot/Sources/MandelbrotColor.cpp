@@ -0,0 +1,485 @@
+#include <math.h>
+#include <algorithm>
+#include "MandelbrotDraw.h"
+#include "MandelbrotSIMD.h"
+
+using namespace Kigs;
+
+// inside the set color
+const uint32_t InsideColor = 0xFF000000;
+
+// distance estimation boundary line width, in pixels (the line is drawn on the escaped side of the boundary)
+const float BoundaryLineWidth = 1.0f;
+
+// palette texture is sampled with |Z| * TextureScale, wrapped on its 256x64 size
+const float TextureScale = 32.0f;
+
+// log2 of the count of texel tiles in a texture row (MandelbrotTextureSizeX is 256)
+const int TextureTileRowShift = 8 - MandelbrotTextureTileShift;
+
+void	MandelbrotPalette::Update(int iterationMax, const unsigned char* texture, bool smooth, int power)
+{
+	mSmooth = smooth;
+	mSmoothScale = (power > 2) ? 1.0f / log2f((float)power) : 1.0f;
+
+	// 24 bits texels are converted once to aligned 32 bits texels, so they can be read with SIMD gathers
+	if (texture != mTexture)
+	{
+		mTexture = texture;
+		if (texture)
+		{
+			mTexels.resize(MandelbrotTextureSizeX * MandelbrotTextureSizeY);
+			for (int y = 0; y < MandelbrotTextureSizeY; y++)
+			{
+				for (int x = 0; x < MandelbrotTextureSizeX; x++)
+				{
+					const unsigned char* texel = &texture[3 * (y * MandelbrotTextureSizeX + x)];
+					mTexels[MandelbrotTextureIndex(x, y)] = (uint32_t)texel[0] | ((uint32_t)texel[1] << 8) | ((uint32_t)texel[2] << 16) | 0xFF000000;
+				}
+			}
+		}
+	}
+
+	if ((iterationMax == mIterationMax) && !mEqualized)
+	{
+		return;
+	}
+	mIterationMax = iterationMax;
+	mEqualized = false;
+
+	mColors.resize(iterationMax + 1);
+	for (int i = 0; i < iterationMax; i++)
+	{
+		uint32_t R = (i << 4) & 255;
+		uint32_t B = ((i >> 4) << 4) & 255;
+		mColors[i] = R | (B << 16) | 0xFF000000;
+	}
+	mColors[iterationMax] = InsideColor;
+}
+
+// equalized palette gradient, t in [0,1] is the share of escaped pixels escaping before this iteration
+struct GradientKey
+{
+	float		t;
+	uint32_t	color;
+};
+
+const GradientKey EqualizedGradient[] =
+{
+	{ 0.0f, 0xFF200000 },
+	{ 0.35f, 0xFFA01000 },
+	{ 0.65f, 0xFF7800C8 },
+	{ 0.85f, 0xFF1080FF },
+	{ 1.0f, 0xFFE0F0FF },
+};
+
+inline uint32_t	equalizedColor(float t)
+{
+	const int keyCount = sizeof(EqualizedGradient) / sizeof(EqualizedGradient[0]);
+	int k = 1;
+	while ((k < keyCount - 1) && (t > EqualizedGradient[k].t))
+	{
+		k++;
+	}
+	const GradientKey& k0 = EqualizedGradient[k - 1];
+	const GradientKey& k1 = EqualizedGradient[k];
+	float f = std::min(std::max((t - k0.t) / (k1.t - k0.t), 0.0f), 1.0f);
+	uint32_t color = 0xFF000000;
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		float c0 = (float)((k0.color >> shift) & 255);
+		float c1 = (float)((k1.color >> shift) & 255);
+		color |= (uint32_t)(c0 + (c1 - c0) * f + 0.5f) << shift;
+	}
+	return color;
+}
+
+// the histogram is estimated on one pixel of each HistogramStep x HistogramStep block :
+// the distribution is the same and the pass is 4 times cheaper (at low iteration counts it cost 15% of the frame)
+const int HistogramStep = 2;
+// sub histograms per thread : neighbour pixels often have the same count, interleaving them
+// avoids waiting for the previous increment of the same bin
+const int HistogramInterleave = 4;
+
+void	MandelbrotPalette::Equalize(const MandelbrotIterationBuffer& buffer)
+{
+	const int iterationMax = mIterationMax;
+	if ((buffer.iterationMax != iterationMax) || (iterationMax <= 0))
+	{
+		return;
+	}
+	const int binCount = iterationMax + 1;
+	const int sizeX = buffer.sizeX;
+	const int rowCount = (buffer.sizeY + HistogramStep - 1) / HistogramStep;
+	const int* iterations = buffer.iterations.data();
+
+	// parallel reduction : each thread fills its own histograms, merged at the end
+	std::vector<uint32_t> histogram(binCount, 0);
+	#pragma omp parallel
+	{
+		std::vector<uint32_t> local(binCount * HistogramInterleave, 0);
+		uint32_t* bins[HistogramInterleave];
+		for (int h = 0; h < HistogramInterleave; h++)
+		{
+			bins[h] = local.data() + h * binCount;
+		}
+
+		#pragma omp for schedule(static) nowait
+		for (int r = 0; r < rowCount; r++)
+		{
+			const int* row = iterations + r * HistogramStep * sizeX;
+			const int blockStep = HistogramStep * HistogramInterleave;
+			int i = 0;
+			for (; i + blockStep <= sizeX; i += blockStep)
+			{
+				for (int h = 0; h < HistogramInterleave; h++)
+				{
+					bins[h][std::min((unsigned)row[i + h * HistogramStep], (unsigned)iterationMax)]++;
+				}
+			}
+			for (; i < sizeX; i += HistogramStep)
+			{
+				bins[0][std::min((unsigned)row[i], (unsigned)iterationMax)]++;
+			}
+		}
+
+		for (int h = 1; h < HistogramInterleave; h++)
+		{
+			for (int k = 0; k < binCount; k++)
+			{
+				bins[0][k] += bins[h][k];
+			}
+		}
+		#pragma omp critical(MandelbrotHistogram)
+		for (int k = 0; k < binCount; k++)
+		{
+			histogram[k] += bins[0][k];
+		}
+	}
+
+	// cumulative distribution of escaped pixels (the last bin is the inside count) gives each count its gradient position
+	long long escaped = 0;
+	for (int k = 0; k < iterationMax; k++)
+	{
+		escaped += histogram[k];
+	}
+	long long cumulative = 0;
+	for (int k = 0; k < iterationMax; k++)
+	{
+		cumulative += histogram[k];
+		float t = (escaped > 0) ? (float)((double)cumulative / (double)escaped) : 0.0f;
+		mColors[k] = equalizedColor(t);
+	}
+	mColors[iterationMax] = InsideColor;
+	mEqualized = true;
+}
+
+// iteration count to color lookup for count pixels
+// (palette entry for iterationMax is the inside color, so no test is needed)
+typedef void (*colorizeLineFunction)(const int* iterations, uint32_t* pixels, int count, const uint32_t* colors);
+
+void	colorizeLineScalarRange(const int* iterations, uint32_t* pixels, int first, int count, const uint32_t* colors)
+{
+	for (int i = first; i < count; i++)
+	{
+		pixels[i] = colors[iterations[i]];
+	}
+}
+
+void	colorizeLineScalar(const int* iterations, uint32_t* pixels, int count, const uint32_t* colors)
+{
+	colorizeLineScalarRange(iterations, pixels, 0, count, colors);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+MANDELBROT_TARGET("avx2")
+void	colorizeLineAVX2(const int* iterations, uint32_t* pixels, int count, const uint32_t* colors)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i index = _mm256_loadu_si256((const __m256i*)(iterations + i));
+		__m256i color = _mm256_i32gather_epi32((const int*)colors, index, 4);
+		_mm256_storeu_si256((__m256i*)(pixels + i), color);
+	}
+	colorizeLineScalarRange(iterations, pixels, i, count, colors);
+}
+
+MANDELBROT_TARGET("avx512f")
+void	colorizeLineAVX512(const int* iterations, uint32_t* pixels, int count, const uint32_t* colors)
+{
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i index = _mm512_loadu_si512((const void*)(iterations + i));
+		__m512i color = _mm512_i32gather_epi32(index, (const void*)colors, 4);
+		_mm512_storeu_si512((void*)(pixels + i), color);
+	}
+	colorizeLineScalarRange(iterations, pixels, i, count, colors);
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+// choose the best available lookup kernel once
+static colorizeLineFunction	selectColorizeLine()
+{
+#ifdef MANDELBROT_X86_SIMD
+	if (MandelbrotCPUSupports(true))
+	{
+		return colorizeLineAVX512;
+	}
+	if (MandelbrotCPUSupports(false))
+	{
+		return colorizeLineAVX2;
+	}
+#endif
+	return colorizeLineScalar;
+}
+
+colorizeLineFunction	gColorizeLine = selectColorizeLine();
+
+// log2 approximation (exponent + quadratic fit of the mantissa), precise enough for color interpolation
+inline float	fastLog2(float x)
+{
+	union
+	{
+		float		f;
+		uint32_t	i;
+	} bits = { x };
+	float exponent = (float)((int)((bits.i >> 23) & 255) - 127);
+	bits.i = (bits.i & 0x007FFFFF) | 0x3F800000;
+	float m = bits.f;
+	return exponent + (-0.34484843f * m + 2.02466578f) * m - 0.67487759f;
+}
+
+// per channel linear interpolation between two palette colors, t in [0,256]
+inline uint32_t	lerpColor(uint32_t c0, uint32_t c1, uint32_t t)
+{
+	// R and B are interpolated together, G alone
+	uint32_t RB = ((((c0 & 0x00FF00FF) * (256 - t)) + ((c1 & 0x00FF00FF) * t)) >> 8) & 0x00FF00FF;
+	uint32_t G = ((((c0 & 0x0000FF00) * (256 - t)) + ((c1 & 0x0000FF00) * t)) >> 8) & 0x0000FF00;
+	return RB | G | 0xFF000000;
+}
+
+// continuous iteration count : n + 1 - log2(log2(|Z|)) / log2(power), interpolated between palette colors
+inline uint32_t	smoothColor(int iteration, float Zx, float Zy, int iterationMax, const uint32_t* colors, float scale)
+{
+	float Z2 = Zx * Zx + Zy * Zy;
+	float nu = (float)iteration + 1.0f - fastLog2(0.5f * fastLog2(Z2)) * scale;
+	if (!(nu > 0.0f))
+	{
+		nu = 0.0f;
+	}
+	int index = (int)nu;
+	if (index >= iterationMax - 1)
+	{
+		return colors[iterationMax - 1];
+	}
+	uint32_t t = (uint32_t)((nu - (float)index) * 256.0f);
+	return lerpColor(colors[index], colors[index + 1], t);
+}
+
+// iteration color averaged with the texture sampled at last Z (green comes from the texture only)
+inline uint32_t	textureColor(uint32_t color, float Zx, float Zy, const uint32_t* texels)
+{
+	int x = (int)(fabsf(Zx) * TextureScale);
+	int y = (int)(fabsf(Zy) * TextureScale);
+	uint32_t texel = texels[MandelbrotTextureIndex(x, y)];
+
+	// R and B are averaged together (halved sums can't overlap)
+	uint32_t RB = (((texel & 0x00FF00FF) + (color & 0x00FF00FF)) >> 1) & 0x00FF00FF;
+	return RB | (texel & 0x0000FF00) | 0xFF000000;
+}
+
+// iteration count and texture lookup for count pixels, same result as textureColor
+typedef void (*colorizeTextureLineFunction)(const int* iterations, const float* Zx, const float* Zy, uint32_t* pixels, int count, const uint32_t* colors, const uint32_t* texels, int iterationMax);
+
+void	colorizeTextureLineScalarRange(const int* iterations, const float* Zx, const float* Zy, uint32_t* pixels, int first, int count, const uint32_t* colors, const uint32_t* texels, int iterationMax)
+{
+	for (int i = first; i < count; i++)
+	{
+		int iteration = iterations[i];
+		pixels[i] = (iteration >= iterationMax) ? InsideColor : textureColor(colors[iteration], Zx[i], Zy[i], texels);
+	}
+}
+
+void	colorizeTextureLineScalar(const int* iterations, const float* Zx, const float* Zy, uint32_t* pixels, int count, const uint32_t* colors, const uint32_t* texels, int iterationMax)
+{
+	colorizeTextureLineScalarRange(iterations, Zx, Zy, pixels, 0, count, colors, texels, iterationMax);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+// texel index of 8 |Z| values, see MandelbrotTextureIndex
+MANDELBROT_TARGET("avx2")
+inline __m256i	textureIndexAVX2(__m256 Zx, __m256 Zy)
+{
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 scale = _mm256_set1_ps(TextureScale);
+	const __m256i tileMask = _mm256_set1_epi32((1 << MandelbrotTextureTileShift) - 1);
+	__m256i x = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_and_ps(Zx, absMask), scale)), _mm256_set1_epi32(MandelbrotTextureSizeX - 1));
+	__m256i y = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_and_ps(Zy, absMask), scale)), _mm256_set1_epi32(MandelbrotTextureSizeY - 1));
+	__m256i tile = _mm256_add_epi32(_mm256_slli_epi32(_mm256_srli_epi32(y, MandelbrotTextureTileShift), TextureTileRowShift), _mm256_srli_epi32(x, MandelbrotTextureTileShift));
+	__m256i inTile = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(y, tileMask), MandelbrotTextureTileShift), _mm256_and_si256(x, tileMask));
+	return _mm256_add_epi32(_mm256_slli_epi32(tile, 2 * MandelbrotTextureTileShift), inTile);
+}
+
+MANDELBROT_TARGET("avx2")
+void	colorizeTextureLineAVX2(const int* iterations, const float* Zx, const float* Zy, uint32_t* pixels, int count, const uint32_t* colors, const uint32_t* texels, int iterationMax)
+{
+	const __m256i RBMask = _mm256_set1_epi32(0x00FF00FF);
+	const __m256i GMask = _mm256_set1_epi32(0x0000FF00);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i inside = _mm256_set1_epi32((int)InsideColor);
+	const __m256i lastOutside = _mm256_set1_epi32(iterationMax - 1);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i iteration = _mm256_loadu_si256((const __m256i*)(iterations + i));
+		__m256i color = _mm256_i32gather_epi32((const int*)colors, iteration, 4);
+		__m256i index = textureIndexAVX2(_mm256_loadu_ps(Zx + i), _mm256_loadu_ps(Zy + i));
+		__m256i texel = _mm256_i32gather_epi32((const int*)texels, index, 4);
+
+		__m256i RB = _mm256_and_si256(_mm256_srli_epi32(_mm256_add_epi32(_mm256_and_si256(texel, RBMask), _mm256_and_si256(color, RBMask)), 1), RBMask);
+		__m256i result = _mm256_or_si256(_mm256_or_si256(RB, _mm256_and_si256(texel, GMask)), alpha);
+		result = _mm256_blendv_epi8(result, inside, _mm256_cmpgt_epi32(iteration, lastOutside));
+		_mm256_storeu_si256((__m256i*)(pixels + i), result);
+	}
+	colorizeTextureLineScalarRange(iterations, Zx, Zy, pixels, i, count, colors, texels, iterationMax);
+}
+
+MANDELBROT_TARGET("avx512f")
+inline __m512i	textureIndexAVX512(__m512 Zx, __m512 Zy)
+{
+	const __m512 scale = _mm512_set1_ps(TextureScale);
+	const __m512i tileMask = _mm512_set1_epi32((1 << MandelbrotTextureTileShift) - 1);
+	__m512i x = _mm512_and_si512(_mm512_cvttps_epi32(_mm512_mul_ps(_mm512_abs_ps(Zx), scale)), _mm512_set1_epi32(MandelbrotTextureSizeX - 1));
+	__m512i y = _mm512_and_si512(_mm512_cvttps_epi32(_mm512_mul_ps(_mm512_abs_ps(Zy), scale)), _mm512_set1_epi32(MandelbrotTextureSizeY - 1));
+	__m512i tile = _mm512_add_epi32(_mm512_slli_epi32(_mm512_srli_epi32(y, MandelbrotTextureTileShift), TextureTileRowShift), _mm512_srli_epi32(x, MandelbrotTextureTileShift));
+	__m512i inTile = _mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(y, tileMask), MandelbrotTextureTileShift), _mm512_and_si512(x, tileMask));
+	return _mm512_add_epi32(_mm512_slli_epi32(tile, 2 * MandelbrotTextureTileShift), inTile);
+}
+
+MANDELBROT_TARGET("avx512f")
+void	colorizeTextureLineAVX512(const int* iterations, const float* Zx, const float* Zy, uint32_t* pixels, int count, const uint32_t* colors, const uint32_t* texels, int iterationMax)
+{
+	const __m512i RBMask = _mm512_set1_epi32(0x00FF00FF);
+	const __m512i GMask = _mm512_set1_epi32(0x0000FF00);
+	const __m512i alpha = _mm512_set1_epi32((int)0xFF000000);
+	const __m512i inside = _mm512_set1_epi32((int)InsideColor);
+	const __m512i iterationMaxV = _mm512_set1_epi32(iterationMax);
+
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i iteration = _mm512_loadu_si512((const void*)(iterations + i));
+		__m512i color = _mm512_i32gather_epi32(iteration, (const void*)colors, 4);
+		__m512i index = textureIndexAVX512(_mm512_loadu_ps(Zx + i), _mm512_loadu_ps(Zy + i));
+		__m512i texel = _mm512_i32gather_epi32(index, (const void*)texels, 4);
+
+		__m512i RB = _mm512_and_si512(_mm512_srli_epi32(_mm512_add_epi32(_mm512_and_si512(texel, RBMask), _mm512_and_si512(color, RBMask)), 1), RBMask);
+		__m512i result = _mm512_or_si512(_mm512_or_si512(RB, _mm512_and_si512(texel, GMask)), alpha);
+		result = _mm512_mask_mov_epi32(result, _mm512_cmpge_epi32_mask(iteration, iterationMaxV), inside);
+		_mm512_storeu_si512((void*)(pixels + i), result);
+	}
+	colorizeTextureLineScalarRange(iterations, Zx, Zy, pixels, i, count, colors, texels, iterationMax);
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+static colorizeTextureLineFunction	selectColorizeTextureLine()
+{
+#ifdef MANDELBROT_X86_SIMD
+	if (MandelbrotCPUSupports(true))
+	{
+		return colorizeTextureLineAVX512;
+	}
+	if (MandelbrotCPUSupports(false))
+	{
+		return colorizeTextureLineAVX2;
+	}
+#endif
+	return colorizeTextureLineScalar;
+}
+
+colorizeTextureLineFunction	gColorizeTextureLine = selectColorizeTextureLine();
+
+uint32_t	MandelbrotPalette::GetColor(int iteration, float Zx, float Zy) const
+{
+	if (iteration >= mIterationMax)
+	{
+		return InsideColor;
+	}
+	uint32_t color = mSmooth ? smoothColor(iteration, Zx, Zy, mIterationMax, mColors.data(), mSmoothScale) : mColors[iteration];
+	if (mTexture)
+	{
+		color = textureColor(color, Zx, Zy, mTexels.data());
+	}
+	return color;
+}
+
+// distance estimation : pixels closer than BoundaryLineWidth pixels to the set boundary fade to black,
+// so the boundary is drawn as an anti-aliased line from a single sample per pixel
+void	shadeBoundaryLine(uint32_t* pixels, const float* distance, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		float t = distance[i] * (256.0f / BoundaryLineWidth);
+		if (t < 256.0f)
+		{
+			pixels[i] = lerpColor(InsideColor, pixels[i], (uint32_t)t);
+		}
+	}
+}
+
+void	ColorizeMandelbrot(unsigned char* pixelsdata, const MandelbrotIterationBuffer& buffer, const MandelbrotPalette& palette)
+{
+	const int iterationMax = buffer.iterationMax;
+	if (palette.GetIterationMax() != iterationMax)
+	{
+		return;
+	}
+
+	const uint32_t* colors = palette.GetColors();
+	const uint32_t* texels = palette.GetTexture();
+	const bool smooth = palette.IsSmooth();
+	const int sizeX = buffer.sizeX;
+	const int sizeY = buffer.sizeY;
+	uint32_t* pixels = (uint32_t*)pixelsdata;
+
+	#pragma omp parallel for
+	for (int j = 0; j < sizeY; j++)
+	{
+		int rowIndex = j * sizeX;
+		const int* iterations = buffer.iterations.data() + rowIndex;
+		uint32_t* line = pixels + rowIndex;
+
+		const float* Zx = buffer.Zx.data() + rowIndex;
+		const float* Zy = buffer.Zy.data() + rowIndex;
+
+		if ((texels == nullptr) && !smooth)
+		{
+			// iteration count only : table lookup
+			gColorizeLine(iterations, line, sizeX, colors);
+		}
+		else if (!smooth)
+		{
+			// table and texture lookups
+			gColorizeTextureLine(iterations, Zx, Zy, line, sizeX, colors, texels, iterationMax);
+		}
+		else
+		{
+			for (int i = 0; i < sizeX; i++)
+			{
+				line[i] = palette.GetColor(iterations[i], Zx[i], Zy[i]);
+			}
+		}
+
+		if (!buffer.distance.empty())
+		{
+			shadeBoundaryLine(line, buffer.distance.data() + rowIndex, sizeX);
+		}
+	}
+}
@@ -1,24 +1,58 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <vector>
-#include "TecLibs/Tec3D.h"
-#include "TinyImage.h"
-
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "MandelbrotDraw.h"
+#include "MandelbrotPerturbation.h"
+#include "MandelbrotKernels.h"
 
 using namespace Kigs;
 
-int IterationMax = 64;
+// deep zoom iteration count grows with zoom, but is bounded to keep frame time reasonable
+const int DeepIterationMax = 8192;
 
-Pict::TinyImage* gpbmp = nullptr;
+// under this size, subdivision border cost is not worth it and tiles are fully computed
+const int MinSubdivideSize = 8;
 
-struct RGBA
-{
-	unsigned char R;
-	unsigned char G;
-	unsigned char B;
-	unsigned char A;
-};
+// reprojected samples are reused only if Z varies less than one palette texel between them
+const float ReprojectionZTolerance = 1.0f / 32.0f;
+
+// reusable pixels between two runs of pixels to compute are computed anyway if there are less than this,
+// so SIMD kernels get longer runs
+const int ReprojectionMinGap = 16;
+
+// reprojected samples are interpolated again at each frame and slowly drift : one row out of this
+// is computed again at each reprojected frame (a different one each frame), so no row is kept longer
+const int ReprojectionRefreshPeriod = 16;
+
+// reprojection costs about the same as a few dozen SIMD float iterations per pixel
+// (or a few double, double-double or perturbation iterations),
+// so it's only used when last frame average iteration count is over this
+const int ReprojectionMinAverageIteration = 64;
+const int ReprojectionMinAverageIterationDeep = 8;
+
+// progressive rendering first pass resolution step, and count of samples computed between two budget checks
+const int ProgressiveFirstStep = 8;
+const int ProgressiveBatchSamples = 4096;
+
+// anti-aliasing : runs of refined pixels separated by less than this are iterated together, so kernels get longer runs
+// (merged pixels are iterated but keep their color; shorter gaps measured slower)
+const int AntialiasMinGap = 8;
+// sample lines are padded to a multiple of the widest SIMD kernel, so short runs don't fall in scalar line ends
+const int AntialiasLineStep = 16;
+
+// deep zoom iteration max is rounded to this step so it does not change every frame (cached inside pixels stay valid)
+const int DeepIterationStep = 64;
+
+// distance estimation subdivision : extra margin (in pixels) on border distances before a tile is considered free of set points
+const float DistanceCoverMargin = 1.0f;
 
 int getIndex(int posX, int posY, int sizeX, int sizeY)
 {
@@ -30,232 +64,1422 @@ int getIndex(int posX, int posY, int sizeX, int sizeY)
 	return -1;
 }
 
-inline void colorFromIteration(RGBA* currentColor,const std::pair<int,v2f>& Iteration)
+// everything needed to iterate a frame : no global state, so several frames can be computed concurrently
+struct DrawContext
 {
-	if (Iteration.first == IterationMax)
+	int						sizeX = 0;
+	int						sizeY = 0;
+	int						iterationMax = 0;
+	MandelbrotPrecision		precision = MandelbrotPrecision::Float;
+	// direct iteration formula (deep zoom is always the standard Mandelbrot set)
+	MandelbrotFormula		formula;
+
+	// float precision : C = (startCx + x * Dx, startCy + y * Dy)
+	float					startCx = 0.0f;
+	float					startCy = 0.0f;
+	float					Dx = 0.0f;
+	float					Dy = 0.0f;
+
+	// other precisions : C = center + (startDCx + x * D, startDCy + y * D)
+	// deep zoom iterates the delta to the reference orbit computed at center
+	const ReferenceOrbit*	orbit = nullptr;
+	DoubleDouble			centerX;
+	DoubleDouble			centerY;
+	double					startDCx = 0.0;
+	double					startDCy = 0.0;
+	double					D = 0.0;
+
+	// per pixel iteration count and last Z output
+	int*					outIterations = nullptr;
+	float*					outZx = nullptr;
+	float*					outZy = nullptr;
+	// per pixel distance to the boundary in pixels, distance estimation only (direct iteration)
+	float*					outDistance = nullptr;
+
+	// iterate count pixels from (x,y), pixel i is at (x + i * stepX, y + i * stepY)
+	// if distance is set, distance estimation kernels are used and distance gets the distances in pixels
+	void	iterateLine(int x, int y, int stepX, int stepY, int count, int* iterations, float* Zx, float* Zy, float* distance = nullptr) const
 	{
-		currentColor->R = 0;
-		currentColor->G = 0;
-		currentColor->B = 0;
-		currentColor->A = 255;
+		if (distance)
+		{
+			iterateLineDistance(x, y, stepX, stepY, count, iterations, Zx, Zy, distance);
+		}
+		else if (orbit)
+		{
+			orbit->IterateLine(startDCx + x * D, startDCy + y * D, stepX * D, stepY * D, count, iterations, Zx, Zy);
+		}
+		else if (precision == MandelbrotPrecision::Double)
+		{
+			MandelbrotIterateLine<double>(centerX.hi + (startDCx + x * D), centerY.hi + (startDCy + y * D), stepX * D, stepY * D, count, iterationMax, iterations, Zx, Zy, formula);
+		}
+		else if (precision == MandelbrotPrecision::DoubleDouble)
+		{
+			MandelbrotIterateLine<DoubleDouble>(centerX + DoubleDouble(startDCx + x * D), centerY + DoubleDouble(startDCy + y * D), DoubleDouble(stepX * D), DoubleDouble(stepY * D), count, iterationMax, iterations, Zx, Zy, formula);
+		}
+		else
+		{
+			MandelbrotIterateLine<float>(startCx + x * Dx, startCy + y * Dy, stepX * Dx, stepY * Dy, count, iterationMax, iterations, Zx, Zy, formula);
+		}
 	}
-	else
+
+	void	iterateLineDistance(int x, int y, int stepX, int stepY, int count, int* iterations, float* Zx, float* Zy, float* distance) const
 	{
-	
-		if (gpbmp)
+		float oneOnD;
+		if (precision == MandelbrotPrecision::Double)
 		{
-			unsigned char* bmpdata=gpbmp->GetPixelData();
+			MandelbrotIterateLineDistance<double>(centerX.hi + (startDCx + x * D), centerY.hi + (startDCy + y * D), stepX * D, stepY * D, count, iterationMax, iterations, Zx, Zy, distance, formula);
+			oneOnD = (float)(1.0 / D);
+		}
+		else if (precision == MandelbrotPrecision::DoubleDouble)
+		{
+			MandelbrotIterateLineDistance<DoubleDouble>(centerX + DoubleDouble(startDCx + x * D), centerY + DoubleDouble(startDCy + y * D), DoubleDouble(stepX * D), DoubleDouble(stepY * D), count, iterationMax, iterations, Zx, Zy, distance, formula);
+			oneOnD = (float)(1.0 / D);
+		}
+		else
+		{
+			MandelbrotIterateLineDistance<float>(startCx + x * Dx, startCy + y * Dy, stepX * Dx, stepY * Dy, count, iterationMax, iterations, Zx, Zy, distance, formula);
+			oneOnD = 1.0f / Dx;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			distance[i] *= oneOnD;
+		}
+	}
 
-			float tst = sqrtf(Iteration.second.x * Iteration.second.x + Iteration.second.y * Iteration.second.y) - 2.0f;
-			if (tst > 4.0f)
-				tst = 4.0f;
+	// iterate count pixels of a row from a sub pixel position (x,y)
+	void	iterateRowAt(double x, double y, int count, int* iterations, float* Zx, float* Zy) const
+	{
+		if (orbit)
+		{
+			orbit->IterateLine(startDCx + x * D, startDCy + y * D, D, 0.0, count, iterations, Zx, Zy);
+		}
+		else if (precision == MandelbrotPrecision::Double)
+		{
+			MandelbrotIterateLine<double>(centerX.hi + (startDCx + x * D), centerY.hi + (startDCy + y * D), D, 0.0, count, iterationMax, iterations, Zx, Zy, formula);
+		}
+		else if (precision == MandelbrotPrecision::DoubleDouble)
+		{
+			MandelbrotIterateLine<DoubleDouble>(centerX + DoubleDouble(startDCx + x * D), centerY + DoubleDouble(startDCy + y * D), DoubleDouble(D), DoubleDouble(0.0), count, iterationMax, iterations, Zx, Zy, formula);
+		}
+		else
+		{
+			MandelbrotIterateLine<float>(startCx + (float)x * Dx, startCy + (float)y * Dy, Dx, 0.0f, count, iterationMax, iterations, Zx, Zy, formula);
+		}
+	}
+};
 
-			tst = (1.0f - (tst * 1.0f/4.0f))*32.0f;
+// rows are iterated by chunks so per pixel results stay on the stack
+const int ChunkSize = 256;
 
-			int x = (fabsf(Iteration.second.x) * 32.0f);
-			int y = (fabsf(Iteration.second.y) * 32.0f);
-		//	int y = tst;
+// compute a horizontal (or vertical) span of pixels in the output buffer
+// uniformIteration is set to the first iteration count found, and to -2 as soon as two iteration counts differ
+void	drawSpan(const DrawContext& ctx, int x, int y, bool column, int count, int& uniformIteration)
+{
+	int		iterations[ChunkSize];
+	float	Zx[ChunkSize];
+	float	Zy[ChunkSize];
+	float	distanceChunk[ChunkSize];
+	float*	distance = ctx.outDistance ? distanceChunk : nullptr;
+
+	int index = getIndex(x, y, ctx.sizeX, ctx.sizeY);
+	int indexStep = column ? ctx.sizeX : 1;
 
-			unsigned char* color = &bmpdata[3 * ((y & 63) * 256 + (x & 255))];
+	for (int chunkStart = 0; chunkStart < count; chunkStart += ChunkSize)
+	{
+		int chunkCount = count - chunkStart;
+		if (chunkCount > ChunkSize)
+		{
+			chunkCount = ChunkSize;
+		}
 
-			int R = ((int)color[0] + ((Iteration.first << 4) & 255))/2;
-			int B = ((int)color[2] + (((Iteration.first >> 4) & 255) << 4)) / 2;
-			currentColor->R = R;
-			currentColor->G = color[1];
-			currentColor->B = B;
-			currentColor->A = 255;
+		if (column)
+		{
+			ctx.iterateLine(x, y + chunkStart, 0, 1, chunkCount, iterations, Zx, Zy, distance);
 		}
 		else
 		{
-			currentColor->R = (unsigned char)((Iteration.first << 4) & 255);
-			currentColor->G = 0;
-			currentColor->B = (unsigned char)(((Iteration.first >> 4) & 255) << 4);
-			currentColor->A = 255;
+			ctx.iterateLine(x + chunkStart, y, 1, 0, chunkCount, iterations, Zx, Zy, distance);
 		}
 
+		for (int i = 0; i < chunkCount; i++)
+		{
+			if (uniformIteration == -1)
+			{
+				uniformIteration = iterations[i];
+			}
+			else if (uniformIteration != iterations[i])
+			{
+				uniformIteration = -2;
+			}
+			ctx.outIterations[index] = iterations[i];
+			ctx.outZx[index] = Zx[i];
+			ctx.outZy[index] = Zy[i];
+			if (distance)
+			{
+				ctx.outDistance[index] = distance[i];
+			}
+			index += indexStep;
+		}
 	}
 }
 
-inline std::pair<int,v2f> iterationLoop(float Cx, float Cy)
+// distance estimation : there's no set point closer to a border pixel than its distance (lower bound),
+// and each inside pixel faces a border pixel of each side on its row and column.
+// So if left and right border distances add up to more than the tile width, every inside pixel is in the disc of its left
+// or right border pixel (same for top and bottom) : the tile holds no set point.
+// Disconnected Julia sets only have an estimate, not a bound, so they never pass
+bool	tileHasNoSetPoint(const DrawContext& ctx, int startX, int startY, int TileSizeX, int TileSizeY)
 {
-	float Zx = Cx;
-	float Zy = Cy;
-	float Zx2 = Zx * Zx;
-	float Zy2 = Zy * Zy;
-	const float ER2 = 4.0f;
+	if (ctx.formula.julia)
+	{
+		return false;
+	}
+	const float* distance = ctx.outDistance;
+	float top = distance[getIndex(startX, startY, ctx.sizeX, ctx.sizeY)];
+	float bottom = distance[getIndex(startX, startY + TileSizeY - 1, ctx.sizeX, ctx.sizeY)];
+	for (int i = 1; i < TileSizeX; i++)
+	{
+		top = std::min(top, distance[getIndex(startX + i, startY, ctx.sizeX, ctx.sizeY)]);
+		bottom = std::min(bottom, distance[getIndex(startX + i, startY + TileSizeY - 1, ctx.sizeX, ctx.sizeY)]);
+	}
+	if ((top + bottom) > (float)(TileSizeY - 1) + 2.0f * DistanceCoverMargin)
+	{
+		return true;
+	}
 
+	float left = distance[getIndex(startX, startY, ctx.sizeX, ctx.sizeY)];
+	float right = distance[getIndex(startX + TileSizeX - 1, startY, ctx.sizeX, ctx.sizeY)];
+	for (int j = 1; j < TileSizeY; j++)
+	{
+		left = std::min(left, distance[getIndex(startX, startY + j, ctx.sizeX, ctx.sizeY)]);
+		right = std::min(right, distance[getIndex(startX + TileSizeX - 1, startY + j, ctx.sizeX, ctx.sizeY)]);
+	}
+	return (left + right) > (float)(TileSizeX - 1) + 2.0f * DistanceCoverMargin;
+}
 
-	int Iteration = 0;
-	for (Iteration = 0; Iteration < IterationMax && ((Zx2 + Zy2) < ER2); Iteration++)
+// Mariani-Silver subdivision : compute the tile border, if all border pixels are inside the set
+// the tile is filled, else the inside is split in four tiles
+void	drawRecursiveTile(const DrawContext& ctx, int startX, int startY, int TileSizeX, int TileSizeY)
+{
+	if ((TileSizeX < MinSubdivideSize) || (TileSizeY < MinSubdivideSize))
 	{
-		Zy = 2.0f * Zx * Zy + Cy;
-		Zx = Zx2 - Zy2 + Cx;
-		Zx2 = Zx * Zx;
-		Zy2 = Zy * Zy;
+		for (int j = 0; j < TileSizeY; j++)
+		{
+			int uniformIteration = -1;
+			drawSpan(ctx, startX, startY + j, false, TileSizeX, uniformIteration);
+		}
+		return;
 	}
 
-	return { Iteration,v2f(Zx,Zy) };
+	int borderIteration = -1;
+
+	// horizontal borders
+	drawSpan(ctx, startX, startY, false, TileSizeX, borderIteration);
+	drawSpan(ctx, startX, startY + TileSizeY - 1, false, TileSizeX, borderIteration);
+
+	// vertical borders
+	drawSpan(ctx, startX, startY + 1, true, TileSizeY - 2, borderIteration);
+	drawSpan(ctx, startX + TileSizeX - 1, startY + 1, true, TileSizeY - 2, borderIteration);
+
+	int insideX = startX + 1;
+	int insideY = startY + 1;
+	int insideSizeX = TileSizeX - 2;
+	int insideSizeY = TileSizeY - 2;
+
+	if (borderIteration >= 0)
+	{
+		// the escaped region of every formula is connected, so a border inside the set gives an inside tile
+		// inside color does not depend on Z, so the border Z is just copied
+		if (borderIteration == ctx.iterationMax)
+		{
+			int borderIndex = getIndex(startX, startY, ctx.sizeX, ctx.sizeY);
+			float fillZx = ctx.outZx[borderIndex];
+			float fillZy = ctx.outZy[borderIndex];
+			for (int j = 0; j < insideSizeY; j++)
+			{
+				int index = getIndex(insideX, insideY + j, ctx.sizeX, ctx.sizeY);
+				for (int i = 0; i < insideSizeX; i++)
+				{
+					ctx.outIterations[index + i] = borderIteration;
+					ctx.outZx[index + i] = fillZx;
+					ctx.outZy[index + i] = fillZy;
+				}
+			}
+		}
+		else
+		{
+			// uniform escaped border : last Z still varies inside, everything must be computed but there's no need to subdivide
+			for (int j = 0; j < insideSizeY; j++)
+			{
+				int uniformIteration = -1;
+				drawSpan(ctx, insideX, insideY + j, false, insideSizeX, uniformIteration);
+			}
+		}
+		return;
+	}
+
+	// a tile without set point has no inside region to find, splitting it would only compute more (and shorter) borders
+	if (ctx.outDistance && tileHasNoSetPoint(ctx, startX, startY, TileSizeX, TileSizeY))
+	{
+		for (int j = 0; j < insideSizeY; j++)
+		{
+			int uniformIteration = -1;
+			drawSpan(ctx, insideX, insideY + j, false, insideSizeX, uniformIteration);
+		}
+		return;
+	}
+
+	int halfX = insideSizeX / 2;
+	int halfY = insideSizeY / 2;
+	drawRecursiveTile(ctx, insideX, insideY, halfX, halfY);
+	drawRecursiveTile(ctx, insideX + halfX, insideY, insideSizeX - halfX, halfY);
+	drawRecursiveTile(ctx, insideX, insideY + halfY, halfX, insideSizeY - halfY);
+	drawRecursiveTile(ctx, insideX + halfX, insideY + halfY, insideSizeX - halfX, insideSizeY - halfY);
 }
 
-void	drawRectangle(unsigned char* pixelsdata, int sizeX, int sizeY, int startX, int startY, int RectSizeX,int RectSizeY, float startCx, float startCy, float Dx, float Dy)
+// frames are split in tiles, visited in Morton (Z) order so consecutive tiles are neighbours in the image
+// and in the reference orbit / palette data they touch
+struct DrawTile
 {
-	// draw square border 
-	RGBA* rgbaPixels = (RGBA*)pixelsdata;
+	int x;
+	int y;
+	int sizeX;
+	int sizeY;
+};
 
-	// first draw horizontal borders
-	
-	#pragma omp parallel for
-	for (int j = 0; j < RectSizeY; j++)
+// interleave the 16 low bits of x and y
+inline uint32_t	mortonKey(uint32_t x, uint32_t y)
+{
+	uint32_t key[2] = { x & 0xFFFF, y & 0xFFFF };
+	for (uint32_t& v : key)
+	{
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+	}
+	return key[0] | (key[1] << 1);
+}
+
+std::vector<DrawTile>	buildTiles(int sizeX, int sizeY, int tileSizeX, int tileSizeY)
+{
+	std::vector<std::pair<uint32_t, DrawTile>> sorted;
+	for (int j = 0; j < sizeY; j += tileSizeY)
+	{
+		for (int i = 0; i < sizeX; i += tileSizeX)
+		{
+			DrawTile toAdd = { i, j, std::min(tileSizeX, sizeX - i), std::min(tileSizeY, sizeY - j) };
+			sorted.push_back(std::make_pair(mortonKey(i / tileSizeX, j / tileSizeY), toAdd));
+		}
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint32_t, DrawTile>& a, const std::pair<uint32_t, DrawTile>& b) { return a.first < b.first; });
+
+	std::vector<DrawTile> tiles;
+	tiles.reserve(sorted.size());
+	for (const auto& t : sorted)
+	{
+		tiles.push_back(t.second);
+	}
+	return tiles;
+}
+
+// work stealing tile queues : each thread owns a contiguous range of the ordered tiles (so its tiles stay close together)
+// and takes tiles at the range begin. When its range is empty, it steals the end half of another thread range.
+// A range is packed in one atomic (begin in high bits, end in low bits), so owner and thieves only need a CAS
+class TileRanges
+{
+public:
+
+	TileRanges(int tileCount, int threadCount) : mRanges(threadCount)
 	{
-		float Cy = startCy + j * Dy;
-		int index = getIndex(startX, j + startY, sizeX, sizeY);
-		
-		for (int i = 0; i < RectSizeX; i++)
+		for (int t = 0; t < threadCount; t++)
 		{
-			float Cx = startCx + i * Dx;
+			uint32_t begin = (uint32_t)(((long long)tileCount * t) / threadCount);
+			uint32_t end = (uint32_t)(((long long)tileCount * (t + 1)) / threadCount);
+			mRanges[t].range.store(pack(begin, end));
+		}
+	}
 
-			auto Iteration = iterationLoop(Cx, Cy);
-			RGBA currentColor;
-			colorFromIteration(&currentColor, Iteration);	
-			rgbaPixels[index] = currentColor;
-			index++;
+	// take next tile of thread own range
+	bool	Pop(int thread, int& tile)
+	{
+		std::atomic<uint64_t>& own = mRanges[thread].range;
+		uint64_t current = own.load();
+		while (begin(current) < end(current))
+		{
+			if (own.compare_exchange_weak(current, pack(begin(current) + 1, end(current))))
+			{
+				tile = (int)begin(current);
+				return true;
+			}
 		}
+		return false;
+	}
+
+	// thread own range is empty : steal half of the first non empty range found, return its first tile
+	// and keep the others as the new own range
+	bool	Steal(int thread, int& tile)
+	{
+		int threadCount = (int)mRanges.size();
+		for (int k = 1; k < threadCount; k++)
+		{
+			std::atomic<uint64_t>& victim = mRanges[(thread + k) % threadCount].range;
+			uint64_t current = victim.load();
+			while (begin(current) < end(current))
+			{
+				uint32_t stolenBegin = end(current) - (end(current) - begin(current) + 1) / 2;
+				if (victim.compare_exchange_weak(current, pack(begin(current), stolenBegin)))
+				{
+					// own range is empty so nobody else modifies it
+					mRanges[thread].range.store(pack(stolenBegin + 1, end(current)));
+					tile = (int)stolenBegin;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+protected:
+
+	static uint64_t	pack(uint32_t begin, uint32_t end)
+	{
+		return ((uint64_t)begin << 32) | end;
+	}
+	static uint32_t	begin(uint64_t range)
+	{
+		return (uint32_t)(range >> 32);
+	}
+	static uint32_t	end(uint64_t range)
+	{
+		return (uint32_t)range;
 	}
 
+	// one cache line per thread range
+	struct ThreadRange
+	{
+		std::atomic<uint64_t>	range;
+		char					padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+	std::vector<ThreadRange>	mRanges;
+};
+
+inline int	maxThreadCount()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+inline int	currentThread()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
 }
 
-void	drawRecursiveSquare(unsigned char* pixelsdata, int sizeX, int sizeY,int startX,int startY, int SquareSize,float startCx,float startCy,float Dx,float Dy)
+// add the time since start to the calling thread busy time (ms), if busy times are collected
+inline void	addBusyTime(std::vector<double>* threadBusyTime, std::chrono::steady_clock::time_point start)
 {
-	// draw square border 
-	RGBA* rgbaPixels = (RGBA*)pixelsdata;
+	if (threadBusyTime)
+	{
+		std::chrono::duration<double, std::milli> busy = std::chrono::steady_clock::now() - start;
+		(*threadBusyTime)[currentThread()] += busy.count();
+	}
+}
 
-	int checkRecurse1 = 0;
-	int checkRecurse2 = 0;
+// draw all tiles on all threads, tile cost is very different between inside, outside and border tiles
+// so they are dispatched with work stealing instead of a static split.
+// A thread is busy until it finds no tile left to steal, its busy time is added to threadBusyTime if set
+// return false if cancel was set before all tiles were drawn (remaining tiles are skipped)
+template<typename TileFunction>
+bool	drawTiles(const std::vector<DrawTile>& tiles, const std::atomic<bool>* cancel, std::vector<double>* threadBusyTime, const TileFunction& drawTile)
+{
+	int threadCount = maxThreadCount();
+	TileRanges ranges((int)tiles.size(), threadCount);
+	std::atomic<bool> cancelled(false);
 
-	std::pair<int, v2f> Iteration;
-	// first draw horizontal borders
-	RGBA currentColor;
-	for (int j = 0; j < SquareSize; j+= SquareSize-1)
+	#pragma omp parallel num_threads(threadCount)
 	{
-		float Cy = startCy + j * Dy;
+		auto threadStart = std::chrono::steady_clock::now();
+		int thread = currentThread();
+		int current;
+		while (ranges.Pop(thread, current) || ranges.Steal(thread, current))
+		{
+			if (cancel && cancel->load(std::memory_order_relaxed))
+			{
+				cancelled = true;
+				break;
+			}
+			drawTile(tiles[current]);
+		}
+		addBusyTime(threadBusyTime, threadStart);
+	}
+	return !cancelled;
+}
 
-		for (int i = 0; i < SquareSize; i++)
+// compute every pixel of the frame, or use Mariani-Silver subdivision in each tile
+// when every pixel is computed, tiles are ChunkSize wide strips with the same pixel count as a square tile :
+// each row start costs a kernel setup and restarts periodicity checking, short rows were 25% slower at low iteration counts
+bool	drawTiled(const DrawContext& ctx, int tileSize, bool subdivide, const std::atomic<bool>* cancel, std::vector<double>* threadBusyTime)
+{
+	if (tileSize < MinSubdivideSize)
+	{
+		tileSize = MinSubdivideSize;
+	}
+	int tileSizeX = tileSize;
+	int tileSizeY = tileSize;
+	if (!subdivide && (tileSize < ChunkSize))
+	{
+		tileSizeX = ChunkSize;
+		tileSizeY = std::max(1, (tileSize * tileSize) / ChunkSize);
+	}
+	std::vector<DrawTile> tiles = buildTiles(ctx.sizeX, ctx.sizeY, tileSizeX, tileSizeY);
+
+	return drawTiles(tiles, cancel, threadBusyTime, [&ctx, subdivide](const DrawTile& t)
+	{
+		if (subdivide)
+		{
+			drawRecursiveTile(ctx, t.x, t.y, t.sizeX, t.sizeY);
+			return;
+		}
+		for (int j = 0; j < t.sizeY; j++)
 		{
-			float Cx = startCx + i * Dx;
+			int uniformIteration = -1;
+			drawSpan(ctx, t.x, t.y + j, false, t.sizeX, uniformIteration);
+		}
+	});
+}
+
+// try to get iteration count and last Z at previous frame position (ix + fx, iy + fy)
+// the sample is reliable only if the four surrounding old pixels have the same iteration count
+// and close Z values (when color depends on Z), then Z is bilinearly interpolated.
+// inside samples don't depend on Z, they are kept as is when iteration max did not change
+inline bool	reprojectSample(const MandelbrotIterationBuffer& previous, int ix, float fx, int iy, float fy, int iterationMax, bool checkZ, int& iteration, float& Zx, float& Zy)
+{
+	int i00 = getIndex(ix, iy, previous.sizeX, previous.sizeY);
+	int i10 = i00 + 1;
+	int i01 = i00 + previous.sizeX;
+	int i11 = i01 + 1;
+
+	const int* it = previous.iterations.data();
+	int sampleIteration = it[i00];
+	if ((it[i10] != sampleIteration) || (it[i01] != sampleIteration) || (it[i11] != sampleIteration))
+	{
+		return false;
+	}
 
-			Iteration = iterationLoop(Cx, Cy);
-			checkRecurse1 |= Iteration.first;
-			checkRecurse2 += Iteration.first;
-			colorFromIteration(&currentColor, Iteration);
-			int index = getIndex(i+startX, j+startY, sizeX, sizeY);
-			rgbaPixels[index] = currentColor;
+	if (sampleIteration >= previous.iterationMax)
+	{
+		// inside points are only known up to the old iteration max
+		if (iterationMax != previous.iterationMax)
+		{
+			return false;
 		}
+		iteration = iterationMax;
+		Zx = previous.Zx[i00];
+		Zy = previous.Zy[i00];
+		return true;
+	}
+	else if (sampleIteration >= iterationMax)
+	{
+		// escaped after the new iteration max, so inside for this frame
+		iteration = iterationMax;
+		Zx = previous.Zx[i00];
+		Zy = previous.Zy[i00];
+		return true;
 	}
 
-	// then draw vertical borders
-	for (int i = 0; i < SquareSize; i += SquareSize - 1)
+	const float* zx = previous.Zx.data();
+	const float* zy = previous.Zy.data();
+	float minX = std::min(std::min(zx[i00], zx[i10]), std::min(zx[i01], zx[i11]));
+	float maxX = std::max(std::max(zx[i00], zx[i10]), std::max(zx[i01], zx[i11]));
+	float minY = std::min(std::min(zy[i00], zy[i10]), std::min(zy[i01], zy[i11]));
+	float maxY = std::max(std::max(zy[i00], zy[i10]), std::max(zy[i01], zy[i11]));
+	if (checkZ && (((maxX - minX) > ReprojectionZTolerance) || ((maxY - minY) > ReprojectionZTolerance)))
 	{
-		float Cx = startCx + i * Dx;
-		
-		for (int j = 1; j < SquareSize-1; j++)
+		return false;
+	}
+
+	Zx = (zx[i00] * (1.0f - fx) + zx[i10] * fx) * (1.0f - fy) + (zx[i01] * (1.0f - fx) + zx[i11] * fx) * fy;
+	Zy = (zy[i00] * (1.0f - fx) + zy[i10] * fx) * (1.0f - fy) + (zy[i01] * (1.0f - fx) + zy[i11] * fx) * fy;
+	iteration = (sampleIteration > iterationMax) ? iterationMax : sampleIteration;
+	return true;
+}
+
+// iterate a frame reusing the previous one : reliable reprojected samples are kept,
+// other pixels are computed by runs so SIMD kernels can still be used
+// offsetX/offsetY is the position of new pixel (0,0) relative to old pixel (0,0)
+// rows with j % ReprojectionRefreshPeriod == refreshRow are fully computed
+// return false if cancel was set before all rows were drawn
+bool	drawReprojected(const DrawContext& ctx, const MandelbrotIterationBuffer& previous, double offsetX, double offsetY, double D, bool checkZ, int refreshRow, const std::atomic<bool>* cancel, std::vector<double>* threadBusyTime, int& reusedPixels)
+{
+	double oneOnOldD = 1.0 / previous.D;
+	int reused = 0;
+	std::atomic<bool> cancelled(false);
+
+	#pragma omp parallel
+	{
+		auto threadStart = std::chrono::steady_clock::now();
+		#pragma omp for reduction(+:reused) schedule(dynamic, 4) nowait
+		for (int j = 0; j < ctx.sizeY; j++)
 		{
-			float Cy = startCy + j * Dy;
+			// can't break out of an omp for, remaining rows are just skipped
+			if (cancel && cancel->load(std::memory_order_relaxed))
+			{
+				cancelled = true;
+				continue;
+			}
+
+			double sy = (offsetY + j * D) * oneOnOldD;
+			int rowIndex = getIndex(0, j, ctx.sizeX, ctx.sizeY);
+
+			// source row must have a row under it
+			bool rowInside = (sy >= 0.0) && (sy < (double)(previous.sizeY - 1)) && ((j % ReprojectionRefreshPeriod) != refreshRow);
+			int iy = rowInside ? (int)sy : 0;
+			float fy = (float)(sy - iy);
+
+			// first pass : reproject, pixels that can't be reused get -1 iteration
+			for (int i = 0; i < ctx.sizeX; i++)
+			{
+				double sx = (offsetX + i * D) * oneOnOldD;
+				int index = rowIndex + i;
+				int iteration;
+				float Zx, Zy;
+				bool inside = rowInside && (sx >= 0.0) && (sx < (double)(previous.sizeX - 1));
+				int ix = inside ? (int)sx : 0;
+				if (inside && reprojectSample(previous, ix, (float)(sx - ix), iy, fy, ctx.iterationMax, checkZ, iteration, Zx, Zy))
+				{
+					ctx.outIterations[index] = iteration;
+					ctx.outZx[index] = Zx;
+					ctx.outZy[index] = Zy;
+					reused++;
+				}
+				else
+				{
+					ctx.outIterations[index] = -1;
+				}
+			}
+
+			// second pass : compute runs of missing pixels, merging runs separated by small gaps
+			int i = 0;
+			while (i < ctx.sizeX)
+			{
+				if (ctx.outIterations[rowIndex + i] >= 0)
+				{
+					i++;
+					continue;
+				}
 
-			Iteration = iterationLoop(Cx, Cy);
-			checkRecurse1 |= Iteration.first;
-			checkRecurse2 += Iteration.first;
-			colorFromIteration(&currentColor, Iteration);
-			int index = getIndex(i + startX, j + startY, sizeX, sizeY);
-			rgbaPixels[index] = currentColor;
-			
+				int runEnd = i + 1;
+				int gap = 0;
+				for (int k = runEnd; k < ctx.sizeX; k++)
+				{
+					if (ctx.outIterations[rowIndex + k] < 0)
+					{
+						runEnd = k + 1;
+						gap = 0;
+					}
+					else if (++gap >= ReprojectionMinGap)
+					{
+						break;
+					}
+				}
+
+				// reused pixels inside merged runs are computed again
+				for (int k = i; k < runEnd; k++)
+				{
+					if (ctx.outIterations[rowIndex + k] >= 0)
+					{
+						reused--;
+					}
+				}
+
+				int uniformIteration = -1;
+				drawSpan(ctx, i, j, false, runEnd - i, uniformIteration);
+				i = runEnd;
+			}
+		}
+		addBusyTime(threadBusyTime, threadStart);
+	}
+	reusedPixels = reused;
+	return !cancelled;
+}
+
+// set average iteration of a finished buffer (used to decide if it's worth reprojecting),
+// and fill iteration stats if requested
+void	countIterations(MandelbrotIterationBuffer& buffer, MandelbrotFrameStats* stats)
+{
+	int pixelCount = buffer.sizeX * buffer.sizeY;
+	int iterationMax = buffer.iterationMax;
+	long long iterationSum = 0;
+	int insidePixels = 0;
+	for (int i = 0; i < pixelCount; i++)
+	{
+		int iteration = buffer.iterations[i];
+		iterationSum += iteration;
+		insidePixels += (iteration >= iterationMax) ? 1 : 0;
+	}
+	buffer.averageIteration = (pixelCount > 0) ? (int)(iterationSum / pixelCount) : 0;
+
+	if (stats)
+	{
+		stats->iterationMax = iterationMax;
+		stats->iterations = iterationSum;
+		stats->insidePixels = insidePixels;
+		stats->escapedPixels = pixelCount - insidePixels;
+		stats->reusedPixels = buffer.reusedPixels;
+
+		double busySum = 0.0;
+		double busyMax = 0.0;
+		for (double busy : stats->threadBusyTime)
+		{
+			busySum += busy;
+			busyMax = std::max(busyMax, busy);
 		}
+		stats->imbalance = (busySum > 0.0) ? busyMax * stats->threadBusyTime.size() / busySum : 1.0;
+	}
+}
+
+// common part of float and deep zoom iteration
+// centerX, centerY, startDCx, startDCy and D give the frame mapping used by reprojection
+// return false if the frame was cancelled, the buffer is then left invalid
+bool	iterateWithSettings(DrawContext& ctx, MandelbrotIterationBuffer& buffer, const MandelbrotIterateSettings& settings, const FixedPoint& centerX, const FixedPoint& centerY, double startDCx, double startDCy, double D)
+{
+	buffer.Resize(ctx.sizeX, ctx.sizeY);
+	ctx.outIterations = buffer.iterations.data();
+	ctx.outZx = buffer.Zx.data();
+	ctx.outZy = buffer.Zy.data();
+
+	buffer.reusedPixels = 0;
+
+	// distance estimation is only implemented for direct iteration
+	if (settings.distanceEstimation && (ctx.orbit == nullptr))
+	{
+		buffer.distance.resize(ctx.sizeX * ctx.sizeY);
+		ctx.outDistance = buffer.distance.data();
+	}
+	else
+	{
+		buffer.distance.clear();
+		ctx.outDistance = nullptr;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<double>* threadBusyTime = nullptr;
+	if (settings.stats)
+	{
+		threadBusyTime = &settings.stats->threadBusyTime;
+		threadBusyTime->assign(maxThreadCount(), 0.0);
+	}
+
+	const MandelbrotIterationBuffer* previous = settings.previous;
+	int minAverageIteration = (ctx.precision == MandelbrotPrecision::Float) ? ReprojectionMinAverageIteration : ReprojectionMinAverageIterationDeep;
+	bool reproject = (previous != nullptr) && (previous != &buffer) && previous->valid && (previous->sizeX > 1) && (previous->sizeY > 1)
+		&& (settings.mode == MandelbrotDrawMode::Full) && (previous->averageIteration >= minAverageIteration) && (previous->formula == ctx.formula)
+		&& (ctx.outDistance == nullptr) && previous->distance.empty();
+
+	bool finished;
+	if (reproject)
+	{
+		double offsetX = (centerX - previous->centerX).ToDouble() + startDCx - previous->startDCx;
+		double offsetY = (centerY - previous->centerY).ToDouble() + startDCy - previous->startDCy;
+		int refreshRow = previous->reprojectedFrames % ReprojectionRefreshPeriod;
+		finished = drawReprojected(ctx, *previous, offsetX, offsetY, D, settings.reprojectNeedsZ, refreshRow, settings.cancel, threadBusyTime, buffer.reusedPixels);
+	}
+	else
+	{
+		finished = drawTiled(ctx, settings.tileSize, settings.mode == MandelbrotDrawMode::Subdivide, settings.cancel, threadBusyTime);
+	}
+
+	if (!finished)
+	{
+		buffer.Invalidate();
+		return false;
+	}
+
+	// this frame can be reprojected by the next one
+	buffer.reprojectedFrames = reproject ? previous->reprojectedFrames + 1 : 0;
+	buffer.iterationMax = ctx.iterationMax;
+	buffer.centerX = centerX;
+	buffer.centerY = centerY;
+	buffer.startDCx = startDCx;
+	buffer.startDCy = startDCy;
+	buffer.D = D;
+	buffer.valid = true;
+	buffer.precision = ctx.precision;
+	buffer.deep = (ctx.orbit != nullptr);
+	buffer.formula = ctx.formula;
+
+	countIterations(buffer, settings.stats);
+	if (settings.stats)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+		settings.stats->iterateTime = elapsed.count();
+	}
+	return true;
+}
+
+// float precision mapping : C = (startCx + x * Dx, startCy + y * Dy)
+void	setupFloatContext(DrawContext& ctx, int sizeX, int sizeY, float zoomCenterX, float zoomCenterY, float zoomCoef)
+{
+	ctx.sizeX = sizeX;
+	ctx.sizeY = sizeY;
+
+	float oneOnZoomCoef = 1.0f / zoomCoef;
+
+	ctx.iterationMax = MandelbrotFloatIterationMax(zoomCoef);
+	ctx.startCy = ( - sizeY / 2) * oneOnZoomCoef + zoomCenterY;
+	ctx.startCx = ( - sizeX / 2) * oneOnZoomCoef + zoomCenterX;
+	ctx.Dx = oneOnZoomCoef;
+	ctx.Dy = oneOnZoomCoef;
+
+	// same mapping relative to the float center, for reprojection
+	ctx.centerX = zoomCenterX;
+	ctx.centerY = zoomCenterY;
+	ctx.startDCx = ctx.startCx - zoomCenterX;
+	ctx.startDCy = ctx.startCy - zoomCenterY;
+	ctx.D = ctx.Dx;
+}
+
+// double, double-double and deep zoom mapping : pixel deltas to the view center, same pixel mapping as float precision
+void	setupDeltaContext(DrawContext& ctx, int sizeX, int sizeY, double zoomCoef)
+{
+	ctx.sizeX = sizeX;
+	ctx.sizeY = sizeY;
+
+	double oneOnZoomCoef = 1.0 / zoomCoef;
+
+	double maxIteration = sqrt(zoomCoef);
+	if (maxIteration > DeepIterationMax)
+	{
+		maxIteration = DeepIterationMax;
+	}
+	ctx.iterationMax = ((int)maxIteration / DeepIterationStep) * DeepIterationStep;
+	if (ctx.iterationMax < DeepIterationStep)
+	{
+		ctx.iterationMax = DeepIterationStep;
 	}
 
-	int countIteration = 4 * (SquareSize-1);
+	ctx.startDCx = (-sizeX / 2) * oneOnZoomCoef;
+	ctx.startDCy = (-sizeY / 2) * oneOnZoomCoef;
+	ctx.D = oneOnZoomCoef;
+}
 
-	if ((checkRecurse1 == Iteration.first) && (checkRecurse2 == (Iteration.first * countIteration)))// fill square
+// direct iteration mapping, using the cheapest precision this zoom allows
+// (float precision mapping is relative to the float rounded center, see mappingCenter)
+void	setupDirectContext(DrawContext& ctx, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef)
+{
+	MandelbrotPrecision precision = MandelbrotPrecisionForZoom(zoomCoef);
+	if (precision == MandelbrotPrecision::Float)
 	{
-		for (int i = 1; i < SquareSize - 1; i++)
+		setupFloatContext(ctx, sizeX, sizeY, (float)zoomCenterX.ToDouble(), (float)zoomCenterY.ToDouble(), (float)zoomCoef);
+		return;
+	}
+	setupDeltaContext(ctx, sizeX, sizeY, zoomCoef);
+	ctx.precision = precision;
+	ctx.centerX = DoubleDouble(zoomCenterX);
+	ctx.centerY = DoubleDouble(zoomCenterY);
+}
+
+// center the frame mapping (startDCx, startDCy, D) is relative to
+inline FixedPoint	mappingCenter(const DrawContext& ctx, const FixedPoint& zoomCenter, const DoubleDouble& contextCenter)
+{
+	return (ctx.precision == MandelbrotPrecision::Float) ? FixedPoint(contextCenter.hi) : zoomCenter;
+}
+
+// deep zoom mapping
+// the orbit must be computed at the view center with ctx.iterationMax and the returned maxDelta before iterating
+double	setupDeepContext(DrawContext& ctx, int sizeX, int sizeY, double zoomCoef, const ReferenceOrbit* orbit)
+{
+	setupDeltaContext(ctx, sizeX, sizeY, zoomCoef);
+	ctx.orbit = orbit;
+
+	// series approximation must be valid up to the view corners
+	return 0.5 * sqrt((double)sizeX * sizeX + (double)sizeY * sizeY) * ctx.D;
+}
+
+bool	IterateMandelbrot(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, const MandelbrotIterateSettings& settings)
+{
+	DrawContext ctx;
+	setupDirectContext(ctx, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef);
+	ctx.formula = settings.formula;
+
+	return iterateWithSettings(ctx, buffer, settings, mappingCenter(ctx, zoomCenterX, ctx.centerX), mappingCenter(ctx, zoomCenterY, ctx.centerY), ctx.startDCx, ctx.startDCy, ctx.D);
+}
+
+bool	IterateMandelbrotDeep(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, const MandelbrotIterateSettings& settings)
+{
+	ReferenceOrbit orbit;
+	return IterateMandelbrotDeep(buffer, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef, orbit, settings);
+}
+
+bool	IterateMandelbrotDeep(MandelbrotIterationBuffer& buffer, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, ReferenceOrbit& orbit, const MandelbrotIterateSettings& settings)
+{
+	// perturbation and series approximation are only implemented for the standard Mandelbrot set
+	if (!settings.formula.IsMandelbrot())
+	{
+		return IterateMandelbrot(buffer, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef, settings);
+	}
+
+	auto orbitStart = std::chrono::steady_clock::now();
+	DrawContext ctx;
+	double maxDelta = setupDeepContext(ctx, sizeX, sizeY, zoomCoef, &orbit);
+	orbit.Compute(zoomCenterX, zoomCenterY, ctx.iterationMax, maxDelta);
+
+	bool finished = iterateWithSettings(ctx, buffer, settings, zoomCenterX, zoomCenterY, ctx.startDCx, ctx.startDCy, ctx.D);
+	if (finished && settings.stats)
+	{
+		// the reference orbit is part of the iteration stage
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - orbitStart;
+		settings.stats->iterateTime = elapsed.count();
+	}
+	return finished;
+}
+
+// iterate the samples of row y for the given resolution step, each sample fills its step x step block
+// when refining, samples already computed by the previous (twice coarser) pass are skipped
+void	refineRow(const DrawContext& ctx, int step, bool firstPass, int y)
+{
+	int		iterations[ChunkSize];
+	float	Zx[ChunkSize];
+	float	Zy[ChunkSize];
+	float	distanceChunk[ChunkSize];
+	float*	distance = ctx.outDistance ? distanceChunk : nullptr;
+
+	int firstX = 0;
+	int stepX = step;
+	if (!firstPass && ((y % (2 * step)) == 0))
+	{
+		firstX = step;
+		stepX = 2 * step;
+	}
+
+	int count = (ctx.sizeX - firstX + stepX - 1) / stepX;
+	int blockSizeY = std::min(step, ctx.sizeY - y);
+
+	for (int chunkStart = 0; chunkStart < count; chunkStart += ChunkSize)
+	{
+		int chunkCount = std::min(count - chunkStart, ChunkSize);
+		int chunkX = firstX + chunkStart * stepX;
+		ctx.iterateLine(chunkX, y, stepX, 0, chunkCount, iterations, Zx, Zy, distance);
+
+		for (int i = 0; i < chunkCount; i++)
 		{
-			int index = getIndex(1 + startX, i + startY, sizeX, sizeY);
-			for (int j = 1; j < SquareSize - 1; j++)
+			int x = chunkX + i * stepX;
+			int blockSizeX = std::min(step, ctx.sizeX - x);
+			for (int j = 0; j < blockSizeY; j++)
 			{
-				rgbaPixels[index] = currentColor;
-				index++;
+				int index = getIndex(x, y + j, ctx.sizeX, ctx.sizeY);
+				for (int k = 0; k < blockSizeX; k++)
+				{
+					ctx.outIterations[index + k] = iterations[i];
+					ctx.outZx[index + k] = Zx[i];
+					ctx.outZy[index + k] = Zy[i];
+				}
+				if (distance)
+				{
+					std::fill(ctx.outDistance + index, ctx.outDistance + index + blockSizeX, distance[i]);
+				}
 			}
 		}
-		
 	}
-	else  // need recurse
+}
+
+void	MandelbrotProgressiveRender::SetView(int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, bool deep, const MandelbrotFormula& formula, bool distanceEstimation)
+{
+	// perturbation only iterates the standard Mandelbrot set, without distance estimation
+	deep = deep && formula.IsMandelbrot();
+	distanceEstimation = distanceEstimation && !deep;
+	if (mStarted && (mBuffer.sizeX == sizeX) && (mBuffer.sizeY == sizeY) && (mZoomCoef == zoomCoef) && (mDeep == deep)
+		&& (mBuffer.centerX == zoomCenterX) && (mBuffer.centerY == zoomCenterY) && (mBuffer.formula == formula) && (mBuffer.distance.empty() != distanceEstimation))
 	{
-		if (SquareSize == 3)
+		return;
+	}
+
+	mStarted = true;
+	mZoomCoef = zoomCoef;
+	mDeep = deep;
+	mStep = ProgressiveFirstStep;
+	mNextRow = 0;
+
+	DrawContext ctx;
+	if (deep)
+	{
+		double maxDelta = setupDeepContext(ctx, sizeX, sizeY, zoomCoef, &mOrbit);
+		mOrbit.Compute(zoomCenterX, zoomCenterY, ctx.iterationMax, maxDelta);
+		mBuffer.startDCx = ctx.startDCx;
+		mBuffer.startDCy = ctx.startDCy;
+		mBuffer.D = ctx.D;
+	}
+	else
+	{
+		setupDirectContext(ctx, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef);
+		mBuffer.startDCx = ctx.startDCx;
+		mBuffer.startDCy = ctx.startDCy;
+		mBuffer.D = ctx.D;
+	}
+	mBuffer.precision = ctx.precision;
+	mBuffer.deep = deep;
+	mBuffer.formula = formula;
+
+	mBuffer.Resize(sizeX, sizeY);
+	if (distanceEstimation)
+	{
+		mBuffer.distance.resize(sizeX * sizeY);
+	}
+	else
+	{
+		mBuffer.distance.clear();
+	}
+	mBuffer.iterationMax = ctx.iterationMax;
+	mBuffer.centerX = zoomCenterX;
+	mBuffer.centerY = zoomCenterY;
+	mBuffer.reusedPixels = 0;
+	mBuffer.reprojectedFrames = 0;
+	mBuffer.valid = false;
+}
+
+bool	MandelbrotProgressiveRender::Update(double budget, MandelbrotFrameStats* stats)
+{
+	if (mStep == 0)
+	{
+		return false;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	DrawContext ctx;
+	if (mDeep)
+	{
+		setupDeepContext(ctx, mBuffer.sizeX, mBuffer.sizeY, mZoomCoef, &mOrbit);
+	}
+	else
+	{
+		setupDirectContext(ctx, mBuffer.sizeX, mBuffer.sizeY, mBuffer.centerX, mBuffer.centerY, mZoomCoef);
+		ctx.formula = mBuffer.formula;
+	}
+	ctx.outIterations = mBuffer.iterations.data();
+	ctx.outZx = mBuffer.Zx.data();
+	ctx.outZy = mBuffer.Zy.data();
+	ctx.outDistance = mBuffer.distance.empty() ? nullptr : mBuffer.distance.data();
+
+	std::vector<double>* threadBusyTime = nullptr;
+	if (stats)
+	{
+		threadBusyTime = &stats->threadBusyTime;
+		threadBusyTime->assign(maxThreadCount(), 0.0);
+	}
+
+	while (mStep > 0)
+	{
+		int step = mStep;
+		bool firstPass = (step == ProgressiveFirstStep);
+		int rowCount = (mBuffer.sizeY + step - 1) / step;
+		int samplesPerRow = (mBuffer.sizeX + step - 1) / step;
+
+		// rows are computed by batches between two time checks
+		int firstRow = mNextRow;
+		int lastRow = firstRow;
+		int samples = 0;
+		while ((lastRow < rowCount) && (samples < ProgressiveBatchSamples))
 		{
-			float Cy = startCy + Dx;
-			float Cx = startCx + Dy;
+			samples += samplesPerRow;
+			lastRow++;
+		}
 
-			Iteration = iterationLoop(Cx, Cy);
-			int index = getIndex(startX + 1, startY + 1, sizeX, sizeY);
-			colorFromIteration(&currentColor, Iteration);
-			rgbaPixels[index] = currentColor;
+		#pragma omp parallel
+		{
+			auto threadStart = std::chrono::steady_clock::now();
+			#pragma omp for schedule(dynamic) nowait
+			for (int r = firstRow; r < lastRow; r++)
+			{
+				refineRow(ctx, step, firstPass, r * step);
+			}
+			addBusyTime(threadBusyTime, threadStart);
 		}
-		else
+
+		mNextRow = lastRow;
+		if (mNextRow >= rowCount)
 		{
-			int subSize = (SquareSize - 2) / 2;
-			drawRecursiveSquare(pixelsdata, sizeX, sizeY, startX + 1, startY + 1, subSize, startCx + Dx * (1.0f), startCy + Dy * (1.0f), Dx, Dy);
-			drawRecursiveSquare(pixelsdata, sizeX, sizeY, startX + 1 + subSize, startY + 1, subSize, startCx + Dx * (1.0f + subSize), startCy + Dy * (1.0f), Dx, Dy);
-			drawRecursiveSquare(pixelsdata, sizeX, sizeY, startX + 1, startY + 1 + subSize, subSize, startCx + Dx * (1.0f), startCy + Dy * (1.0f + subSize), Dx, Dy);
-			drawRecursiveSquare(pixelsdata, sizeX, sizeY, startX + 1 + subSize, startY + 1 + subSize, subSize, startCx + Dx * (1.0f + subSize), startCy + Dy * (1.0f + subSize), Dx, Dy);
+			mStep /= 2;
+			mNextRow = 0;
 		}
+
+		// the first pass is always finished, so the whole view is covered
+		if (mStep < ProgressiveFirstStep)
+		{
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+			if (elapsed.count() >= budget)
+			{
+				break;
+			}
+		}
+	}
+
+	if ((mStep == 0) || stats)
+	{
+		countIterations(mBuffer, stats);
+		mBuffer.valid = (mStep == 0);
+	}
+	if (stats)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+		stats->iterateTime = elapsed.count();
 	}
+	return true;
 }
 
-void	DrawMandelbrot(unsigned char* pixelsdata, int sizeX, int sizeY, float zoomCenterX, float zoomCenterY, float zoomCoef, Pict::TinyImage* bmp)
+void	MandelbrotTiledRender::SetView(int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, bool deep, int supersample, const MandelbrotFormula& formula)
 {
-	gpbmp = bmp;
-	RGBA* rgbaPixels = (RGBA*)pixelsdata;
+	if (supersample < 1)
+	{
+		supersample = 1;
+	}
+	// perturbation only iterates the standard Mandelbrot set
+	deep = deep && formula.IsMandelbrot();
+	mCenterX = zoomCenterX;
+	mCenterY = zoomCenterY;
+	mSampleZoomCoef = zoomCoef * supersample;
+	mSampleSizeX = sizeX * supersample;
+	mSampleSizeY = sizeY * supersample;
+	mDeep = deep;
+	mFormula = formula;
+	// samples of a pixel are centered on it
+	mSampleOffset = -0.5 * (supersample - 1);
 
-	memset(rgbaPixels, 0, sizeof(RGBA) * sizeX * sizeY);
+	// iteration max of the output zoom, so supersampled colors match a direct render
+	DrawContext ctx;
+	if (deep)
+	{
+		setupDeltaContext(ctx, sizeX, sizeY, zoomCoef);
+	}
+	else
+	{
+		setupDirectContext(ctx, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef);
+	}
+	mIterationMax = ctx.iterationMax;
 
-	float oneOnZoomCoef = 1.0f / zoomCoef;
+	if (deep)
+	{
+		// series approximation valid up to the whole image corners
+		double maxDelta = setupDeepContext(ctx, mSampleSizeX, mSampleSizeY, mSampleZoomCoef, &mOrbit);
+		mOrbit.Compute(zoomCenterX, zoomCenterY, mIterationMax, maxDelta);
+	}
+}
+
+bool	MandelbrotTiledRender::IterateTile(MandelbrotIterationBuffer& buffer, int x, int y, int tileSizeX, int tileSizeY, const MandelbrotIterateSettings& settings) const
+{
+	DrawContext ctx;
+	if (mDeep)
+	{
+		setupDeepContext(ctx, mSampleSizeX, mSampleSizeY, mSampleZoomCoef, &mOrbit);
+	}
+	else
+	{
+		setupDirectContext(ctx, mSampleSizeX, mSampleSizeY, mCenterX, mCenterY, mSampleZoomCoef);
+		ctx.formula = mFormula;
+	}
+	ctx.iterationMax = mIterationMax;
 
-	IterationMax = sqrtf(zoomCoef);
-	if (IterationMax > 255)
+	// whole image mapping, shifted to the tile origin
+	ctx.sizeX = tileSizeX;
+	ctx.sizeY = tileSizeY;
+	ctx.startCx += (float)(x + mSampleOffset) * ctx.Dx;
+	ctx.startCy += (float)(y + mSampleOffset) * ctx.Dy;
+	ctx.startDCx += (x + mSampleOffset) * ctx.D;
+	ctx.startDCy += (y + mSampleOffset) * ctx.D;
+
+	// tiles don't overlap, nothing to reproject
+	MandelbrotIterateSettings tileSettings = settings;
+	tileSettings.previous = nullptr;
+	if (mDeep)
 	{
-		IterationMax = 255;
+		return iterateWithSettings(ctx, buffer, tileSettings, mCenterX, mCenterY, ctx.startDCx, ctx.startDCy, ctx.D);
 	}
-	float Cy = ( - sizeY / 2) * oneOnZoomCoef + zoomCenterY;
-	float Cx = ( - sizeX / 2) * oneOnZoomCoef + zoomCenterX;
-	drawRectangle(pixelsdata, sizeX, sizeY, 0, 0, sizeX, sizeY, Cx, Cy, oneOnZoomCoef, oneOnZoomCoef);
+	return iterateWithSettings(ctx, buffer, tileSettings, mappingCenter(ctx, mCenterX, ctx.centerX), mappingCenter(ctx, mCenterY, ctx.centerY), ctx.startDCx, ctx.startDCy, ctx.D);
+}
+
+// rebuild the context that iterated buffer (direct or deep)
+void	setupBufferContext(DrawContext& ctx, const MandelbrotIterationBuffer& buffer, const ReferenceOrbit* orbit)
+{
+	ctx.sizeX = buffer.sizeX;
+	ctx.sizeY = buffer.sizeY;
+	ctx.iterationMax = buffer.iterationMax;
+	ctx.precision = buffer.precision;
+	ctx.formula = buffer.formula;
+	ctx.orbit = buffer.deep ? orbit : nullptr;
+	ctx.centerX = DoubleDouble(buffer.centerX);
+	ctx.centerY = DoubleDouble(buffer.centerY);
+	ctx.startDCx = buffer.startDCx;
+	ctx.startDCy = buffer.startDCy;
+	ctx.D = buffer.D;
+	ctx.startCx = (float)(ctx.centerX.hi + buffer.startDCx);
+	ctx.startCy = (float)(ctx.centerY.hi + buffer.startDCy);
+	ctx.Dx = (float)buffer.D;
+	ctx.Dy = (float)buffer.D;
+}
+
+// sum of RGB channel differences
+inline int	colorDistance(uint32_t c0, uint32_t c1)
+{
+	int R = (int)(c0 & 255) - (int)(c1 & 255);
+	int G = (int)((c0 >> 8) & 255) - (int)((c1 >> 8) & 255);
+	int B = (int)((c0 >> 16) & 255) - (int)((c1 >> 16) & 255);
+	return abs(R) + abs(G) + abs(B);
+}
+
+// deterministic jitter in [0,1) for sample k of row y (stable from frame to frame, no flickering)
+inline double	antialiasJitter(int y, int k, int axis)
+{
+	uint32_t h = (uint32_t)y * 0x9E3779B1u ^ (uint32_t)(k * 2 + axis) * 0x85EBCA77u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return (double)(h & 0xFFFF) / 65536.0;
+}
+
+// the color difference between two neighbours is over threshold
+// (when colors only depend on iteration count, the cheaper count comparison discards most pixels)
+inline bool	isColorEdge(const uint32_t* pixels, const int* iterations, int index, int other, bool usesZ, int threshold)
+{
+	return (usesZ || (iterations[index] != iterations[other])) && (colorDistance(pixels[index], pixels[other]) > threshold);
+}
+
+// iterate sample k of each pixel of line[first, first + count) (row j) and add its color to the RGB sums
+// of the pixels set in mask (the others are only iterated so kernels get longer runs)
+// if given, differ is set for the pixels whose sample color differs from the pixel color
+void	addAntialiasSamples(const DrawContext& ctx, const MandelbrotPalette& palette, int grid, int k, int j, const uint32_t* line, int first, int count, int threshold, const unsigned char* mask, uint32_t* sums, unsigned char* differ)
+{
+	int		iterations[ChunkSize];
+	float	Zx[ChunkSize];
+	float	Zy[ChunkSize];
+
+	double offsetX = ((k % grid) + antialiasJitter(j, k, 0)) / grid - 0.5;
+	double offsetY = ((k / grid) + antialiasJitter(j, k, 1)) / grid - 0.5;
+	int lineCount = std::min(ChunkSize, ((count + AntialiasLineStep - 1) / AntialiasLineStep) * AntialiasLineStep);
+	ctx.iterateRowAt(first + offsetX, j + offsetY, lineCount, iterations, Zx, Zy);
+
+	for (int n = 0; n < count; n++)
+	{
+		if (!mask[n])
+		{
+			continue;
+		}
+		uint32_t color = palette.GetColor(iterations[n], Zx[n], Zy[n]);
+		uint32_t* sum = sums + n * 3;
+		sum[0] += color & 255;
+		sum[1] += (color >> 8) & 255;
+		sum[2] += (color >> 16) & 255;
+		if (differ && (colorDistance(color, line[first + n]) > threshold))
+		{
+			differ[n] = 1;
+		}
+	}
+}
 
-	/*
+// end of the run of set flags starting at flags[first], runs separated by less than AntialiasMinGap unset flags are merged
+inline int	antialiasRunEnd(const unsigned char* flags, int first, int end)
+{
+	int runEnd = first + 1;
+	int gap = 0;
+	while ((runEnd < end) && (gap < AntialiasMinGap))
+	{
+		gap = flags[runEnd] ? 0 : gap + 1;
+		runEnd++;
+	}
+	return runEnd - gap;
+}
+
+bool	AntialiasMandelbrot(unsigned char* pixelsdata, const MandelbrotIterationBuffer& buffer, const MandelbrotPalette& palette, const ReferenceOrbit* orbit, const MandelbrotAntialiasSettings& settings)
+{
+	// distance estimation boundary lines are already anti-aliased
+	if ((palette.GetIterationMax() != buffer.iterationMax) || (buffer.deep && !orbit) || !buffer.distance.empty())
+	{
+		return true;
+	}
+	int grid = (int)sqrt((double)settings.samples);
+	if (grid < 1)
+	{
+		return true;
+	}
+
+	// grid cells on the diagonal are sampled first, the others only if those don't match the pixel
+	std::vector<int> cellOrder;
+	for (int k = 0; k < grid * grid; k++)
+	{
+		if ((k % grid) == (k / grid))
+		{
+			cellOrder.push_back(k);
+		}
+	}
+	for (int k = 0; k < grid * grid; k++)
+	{
+		if ((k % grid) != (k / grid))
+		{
+			cellOrder.push_back(k);
+		}
+	}
+
+	DrawContext ctx;
+	setupBufferContext(ctx, buffer, orbit);
+
+	const int sizeX = buffer.sizeX;
+	const int sizeY = buffer.sizeY;
+	const int threshold = settings.threshold;
+	const bool usesZ = palette.UsesZ();
+	const int* iterations = buffer.iterations.data();
+	uint32_t* pixels = (uint32_t*)pixelsdata;
+
+	// edge detection on the final colors, so only visible steps are refined
+	std::vector<unsigned char> refine(sizeX * sizeY);
 	#pragma omp parallel for
-	for (int j = 0; j < sizeY-78; j+=78)
+	for (int j = 0; j < sizeY; j++)
 	{
-		float Cy = (j - sizeY/2) * oneOnZoomCoef + zoomCenterY;
+		for (int i = 0; i < sizeX; i++)
+		{
+			int index = getIndex(i, j, sizeX, sizeY);
+			refine[index] = ((i > 0) && isColorEdge(pixels, iterations, index, index - 1, usesZ, threshold))
+				|| ((i + 1 < sizeX) && isColorEdge(pixels, iterations, index, index + 1, usesZ, threshold))
+				|| ((j > 0) && isColorEdge(pixels, iterations, index, index - sizeX, usesZ, threshold))
+				|| ((j + 1 < sizeY) && isColorEdge(pixels, iterations, index, index + sizeX, usesZ, threshold));
+		}
+	}
+
+	std::atomic<bool> cancelled{ false };
 
-		for (int i = 0; i < sizeX-78; i+=78)
+	#pragma omp parallel for schedule(dynamic,4)
+	for (int j = 0; j < sizeY; j++)
+	{
+		if (cancelled || (settings.cancel && *settings.cancel))
 		{
-			float Cx = (i - sizeX/2) * oneOnZoomCoef + zoomCenterX;
+			cancelled = true;
+			continue;
+		}
+
+		// RGB sums and sample count of each pixel of the run, and pixels which got a sample of another color
+		uint32_t		sums[ChunkSize * 3];
+		int				sampleCounts[ChunkSize];
+		unsigned char	differ[ChunkSize];
+
+		const unsigned char* rowRefine = refine.data() + j * sizeX;
+		uint32_t* line = pixels + j * sizeX;
+		int i = 0;
+		while (i < sizeX)
+		{
+			if (!rowRefine[i])
+			{
+				i++;
+				continue;
+			}
+			// run of pixels to refine, small gaps included (iterated but left as is), at most ChunkSize long
+			int runStart = i;
+			int runEnd = antialiasRunEnd(rowRefine, i, std::min(sizeX, i + ChunkSize));
+			int count = runEnd - runStart;
+			const unsigned char* runRefine = rowRefine + runStart;
+
+			// the existing pixel is the first sample
+			for (int n = 0; n < count; n++)
+			{
+				uint32_t color = line[runStart + n];
+				sums[n * 3] = color & 255;
+				sums[n * 3 + 1] = (color >> 8) & 255;
+				sums[n * 3 + 2] = (color >> 16) & 255;
+				sampleCounts[n] = 1 + grid;
+				differ[n] = 0;
+			}
+
+			// first pass : one jittered sample in each diagonal cell of a grid x grid stratification of the pixel,
+			// pixels where one of them differs from the pixel color get the remaining cells, by runs of such pixels
+			for (int s = 0; s < grid; s++)
+			{
+				addAntialiasSamples(ctx, palette, grid, cellOrder[s], j, line, runStart, count, threshold, runRefine, sums, differ);
+			}
+			int differStart = 0;
+			while (differStart < count)
+			{
+				if (!differ[differStart])
+				{
+					differStart++;
+					continue;
+				}
+				int differEnd = antialiasRunEnd(differ, differStart, count);
+				for (size_t s = grid; s < cellOrder.size(); s++)
+				{
+					addAntialiasSamples(ctx, palette, grid, cellOrder[s], j, line, runStart + differStart, differEnd - differStart, threshold, differ + differStart, sums + differStart * 3, nullptr);
+				}
+				for (int n = differStart; n < differEnd; n++)
+				{
+					if (differ[n])
+					{
+						sampleCounts[n] = 1 + (int)cellOrder.size();
+					}
+				}
+				differStart = differEnd;
+			}
 
-			drawRecursiveSquare(pixelsdata, sizeX, sizeY, i, j, 78, Cx, Cy, oneOnZoomCoef, oneOnZoomCoef);
+			for (int n = 0; n < count; n++)
+			{
+				if (!runRefine[n])
+				{
+					continue;
+				}
+				uint32_t total = sampleCounts[n];
+				uint32_t R = (sums[n * 3] + total / 2) / total;
+				uint32_t G = (sums[n * 3 + 1] + total / 2) / total;
+				uint32_t B = (sums[n * 3 + 2] + total / 2) / total;
+				line[runStart + n] = R | (G << 8) | (B << 16) | 0xFF000000;
+			}
+			i = runEnd;
 		}
 	}
+	return !cancelled;
+}
 
-	int testX = sizeX / 78;
-	int rectStartX = testX * 78;
-	int rectSizeX = sizeX - rectStartX;
-	int testY = sizeY / 78;
-	int rectStartY = testY * 78;
-	int rectSizeY = sizeY - rectStartY;
+void	DrawMandelbrot(unsigned char* pixelsdata, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, const unsigned char* texture, MandelbrotDrawMode mode, int tileSize, MandelbrotFrameStats* stats)
+{
+	MandelbrotIterateSettings settings;
+	settings.mode = mode;
+	settings.tileSize = tileSize;
+	settings.stats = stats;
 
-	float Cx = (rectStartX - sizeX / 2) * oneOnZoomCoef + zoomCenterX;
-	float Cy = (0 - sizeY / 2) * oneOnZoomCoef + zoomCenterY;
+	MandelbrotIterationBuffer buffer;
+	IterateMandelbrot(buffer, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef, settings);
 
-	drawRectangle(pixelsdata, sizeX, sizeY, rectStartX, 0, rectSizeX, sizeY, Cx, Cy, oneOnZoomCoef, oneOnZoomCoef);
+	auto colorizeStart = std::chrono::steady_clock::now();
+	MandelbrotPalette palette;
+	palette.Update(buffer.iterationMax, texture, false);
+	ColorizeMandelbrot(pixelsdata, buffer, palette);
+	if (stats)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - colorizeStart;
+		stats->colorizeTime = elapsed.count();
+		stats->antialiasTime = 0.0;
+	}
+}
+
+void	DrawMandelbrotDeep(unsigned char* pixelsdata, int sizeX, int sizeY, const FixedPoint& zoomCenterX, const FixedPoint& zoomCenterY, double zoomCoef, const unsigned char* texture, MandelbrotDrawMode mode, int tileSize, MandelbrotFrameStats* stats)
+{
+	MandelbrotIterateSettings settings;
+	settings.mode = mode;
+	settings.tileSize = tileSize;
+	settings.stats = stats;
 
-	Cx = (0 - sizeX / 2) * oneOnZoomCoef + zoomCenterX;
-	Cy = (rectStartY - sizeY / 2)* oneOnZoomCoef + zoomCenterY;
+	MandelbrotIterationBuffer buffer;
+	IterateMandelbrotDeep(buffer, sizeX, sizeY, zoomCenterX, zoomCenterY, zoomCoef, settings);
 
-	drawRectangle(pixelsdata, sizeX, sizeY, 0, rectStartY, rectStartX, rectSizeY, Cx, Cy, oneOnZoomCoef, oneOnZoomCoef);
-	*/
-}
\ No newline at end of file
+	auto colorizeStart = std::chrono::steady_clock::now();
+	MandelbrotPalette palette;
+	palette.Update(buffer.iterationMax, texture, false);
+	ColorizeMandelbrot(pixelsdata, buffer, palette);
+	if (stats)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - colorizeStart;
+		stats->colorizeTime = elapsed.count();
+		stats->antialiasTime = 0.0;
+	}
+}
@@ -0,0 +1,1625 @@
+#include <math.h>
+#include <algorithm>
+#include "MandelbrotDraw.h"
+#include "MandelbrotKernels.h"
+#include "MandelbrotSIMD.h"
+
+using namespace Kigs;
+
+// float kernels : orbits coming back closer than this to a saved point are considered periodic (inside)
+const float PeriodicityTolerance2 = 1.0e-12f;
+// double and double-double kernels : the tolerance is given in pixels, as for perturbation
+const double PeriodicityPixelTolerance = 2.0;
+// first saved orbit point iteration, then saved again each time the iteration count doubles
+const int PeriodicityFirstSave = 8;
+
+// squared periodicity tolerance for a line with this pixel step
+// float lines use the fixed PeriodicityTolerance2 whatever the zoom
+inline float	periodicityTolerance2(float, float)
+{
+	return PeriodicityTolerance2;
+}
+
+// double lines : PeriodicityPixelTolerance pixels, so it scales with zoom
+inline double	periodicityTolerance2(double Dx, double Dy)
+{
+	return PeriodicityPixelTolerance * PeriodicityPixelTolerance * (Dx * Dx + Dy * Dy);
+}
+
+inline DoubleDouble	periodicityTolerance2(const DoubleDouble& Dx, const DoubleDouble& Dy)
+{
+	return periodicityTolerance2(Dx.hi, Dy.hi);
+}
+
+// last Z is only used for coloring
+inline float	toFloat(float v)
+{
+	return v;
+}
+
+inline float	toFloat(double v)
+{
+	return (float)v;
+}
+
+inline float	toFloat(const DoubleDouble& v)
+{
+	return (float)v.hi;
+}
+
+// distance estimate only needs double precision
+inline double	toDouble(float v)
+{
+	return v;
+}
+
+inline double	toDouble(double v)
+{
+	return v;
+}
+
+inline double	toDouble(const DoubleDouble& v)
+{
+	return v.hi;
+}
+
+template<typename T>
+using iterationLineFunction = void (*)(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int count, int iterationMax, int* iterations, float* Zx, float* Zy);
+
+template<typename T>
+using distanceLineFunction = void (*)(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance);
+
+// new Z = Z^Power + C, Zx2 and Zy2 are the squares of Zx and Zy
+// power 2 keeps the historical operation order, higher powers multiply Z^2 by Z
+template<int Power, typename T>
+inline void	formulaStep(T Zx, T Zy, T Zx2, T Zy2, T Cx, T Cy, T& newZx, T& newZy)
+{
+	if (Power == 2)
+	{
+		newZy = (T)2.0 * Zx * Zy + Cy;
+		newZx = Zx2 - Zy2 + Cx;
+		return;
+	}
+	T Px = Zx2 - Zy2;
+	T Py = (T)2.0 * Zx * Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		T nextPx = Px * Zx - Py * Zy;
+		Py = Px * Zy + Py * Zx;
+		Px = nextPx;
+	}
+	newZx = Px + Cx;
+	newZy = Py + Cy;
+}
+
+// scalar version, also used for the last pixels of a line in SIMD versions
+// Mandelbrot family : C is the pixel and Z starts at C, Julia family : C is (juliaCx, juliaCy) and Z starts at the pixel
+// standard Mandelbrot points in the main cardioid or period 2 bulb are not iterated, and orbits falling in an attracting cycle
+// (Brent periodicity check) stop early, both are reported as inside (iterationMax)
+template<int Power, bool Julia, typename T>
+void	iterationLineScalarRange(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int first, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const T ER2 = (T)4.0;
+	const T tolerance2 = periodicityTolerance2(Dx, Dy);
+	// periodicity checking costs a few operations per iteration, so it's only done after an inside pixel
+	bool checkPeriodicity = true;
+	for (int i = first; i < count; i++)
+	{
+		T Zx = startCx + (T)i * Dx;
+		T Zy = startCy + (T)i * Dy;
+		if (!Julia && (Power == 2) && MandelbrotInsideCardioidOrBulb(Zx, Zy))
+		{
+			iterations[i] = iterationMax;
+			outZx[i] = toFloat(Zx);
+			outZy[i] = toFloat(Zy);
+			checkPeriodicity = true;
+			continue;
+		}
+
+		T Cx = Julia ? juliaCx : Zx;
+		T Cy = Julia ? juliaCy : Zy;
+		T Zx2 = Zx * Zx;
+		T Zy2 = Zy * Zy;
+
+		// saved orbit point, moved forward at each power of two iteration
+		T Sx = Zx;
+		T Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		int Iteration = 0;
+		for (Iteration = 0; Iteration < iterationMax && ((Zx2 + Zy2) < ER2); Iteration++)
+		{
+			formulaStep<Power>(Zx, Zy, Zx2, Zy2, Cx, Cy, Zx, Zy);
+			Zx2 = Zx * Zx;
+			Zy2 = Zy * Zy;
+
+			if (checkPeriodicity)
+			{
+				T dx = Zx - Sx;
+				T dy = Zy - Sy;
+				if ((dx * dx + dy * dy) < tolerance2)
+				{
+					Iteration = iterationMax;
+					break;
+				}
+				if (Iteration == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+		checkPeriodicity = (Iteration == iterationMax);
+		iterations[i] = Iteration;
+		outZx[i] = toFloat(Zx);
+		outZy[i] = toFloat(Zy);
+	}
+}
+
+template<int Power, bool Julia, typename T>
+void	iterationLineScalar(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int count, int iterationMax, int* iterations, float* Zx, float* Zy)
+{
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, 0, count, iterationMax, iterations, Zx, Zy);
+}
+
+// new dZ = Power Z^(Power-1) dZ, + 1 for the Mandelbrot family (Z starts at C), Z is the value before the step
+template<int Power, bool Julia, typename T>
+inline void	derivativeStep(T Zx, T Zy, T dZx, T dZy, T& newdZx, T& newdZy)
+{
+	T Qx = Zx;
+	T Qy = Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		T nextQx = Qx * Zx - Qy * Zy;
+		Qy = Qx * Zy + Qy * Zx;
+		Qx = nextQx;
+	}
+	const T power = (T)(double)Power;
+	Qx = power * Qx;
+	Qy = power * Qy;
+	T resultX = Qx * dZx - Qy * dZy;
+	newdZy = Qx * dZy + Qy * dZx;
+	newdZx = Julia ? resultX : resultX + (T)1.0;
+}
+
+// |Z| ln|Z| / (2 |dZ|) from last Z and dZ of an escaped orbit, 0 if dZ overflowed (infinite or NaN)
+inline float	distanceEstimate(double Zx, double Zy, double dZx, double dZy)
+{
+	double Z2 = Zx * Zx + Zy * Zy;
+	double dZ2 = dZx * dZx + dZy * dZy;
+	double distance = 0.25 * sqrt(Z2 / dZ2) * log(Z2);
+	return (distance > 0.0) ? (float)distance : 0.0f;
+}
+
+// scalar distance estimation kernel, same iteration as iterationLineScalarRange with a larger escape radius and dZ
+template<int Power, bool Julia, typename T>
+void	distanceLineScalarRange(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int first, int count, int iterationMax, int* iterations, float* outZx, float* outZy, float* outDistance)
+{
+	const T ER2 = (T)MandelbrotDistanceEscapeRadius2;
+	const T tolerance2 = periodicityTolerance2(Dx, Dy);
+	bool checkPeriodicity = true;
+	for (int i = first; i < count; i++)
+	{
+		T Zx = startCx + (T)i * Dx;
+		T Zy = startCy + (T)i * Dy;
+		if (!Julia && (Power == 2) && MandelbrotInsideCardioidOrBulb(Zx, Zy))
+		{
+			iterations[i] = iterationMax;
+			outZx[i] = toFloat(Zx);
+			outZy[i] = toFloat(Zy);
+			outDistance[i] = 0.0f;
+			checkPeriodicity = true;
+			continue;
+		}
+
+		T Cx = Julia ? juliaCx : Zx;
+		T Cy = Julia ? juliaCy : Zy;
+		T Zx2 = Zx * Zx;
+		T Zy2 = Zy * Zy;
+		T dZx = (T)1.0;
+		T dZy = (T)0.0;
+
+		T Sx = Zx;
+		T Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		int Iteration = 0;
+		for (Iteration = 0; Iteration < iterationMax && ((Zx2 + Zy2) < ER2); Iteration++)
+		{
+			derivativeStep<Power, Julia>(Zx, Zy, dZx, dZy, dZx, dZy);
+			formulaStep<Power>(Zx, Zy, Zx2, Zy2, Cx, Cy, Zx, Zy);
+			Zx2 = Zx * Zx;
+			Zy2 = Zy * Zy;
+
+			if (checkPeriodicity)
+			{
+				T dx = Zx - Sx;
+				T dy = Zy - Sy;
+				if ((dx * dx + dy * dy) < tolerance2)
+				{
+					Iteration = iterationMax;
+					break;
+				}
+				if (Iteration == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+		checkPeriodicity = (Iteration == iterationMax);
+		iterations[i] = Iteration;
+		outZx[i] = toFloat(Zx);
+		outZy[i] = toFloat(Zy);
+		outDistance[i] = (Iteration < iterationMax) ? distanceEstimate(toDouble(Zx), toDouble(Zy), toDouble(dZx), toDouble(dZy)) : 0.0f;
+	}
+}
+
+template<int Power, bool Julia, typename T>
+void	distanceLineScalar(T startCx, T startCy, T Dx, T Dy, T juliaCx, T juliaCy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance)
+{
+	distanceLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, 0, count, iterationMax, iterations, Zx, Zy, distance);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+// SIMD versions of formulaStep, with the same operation order
+template<int Power>
+MANDELBROT_TARGET("avx2")
+inline void	formulaStepAVX2(__m256 Zx, __m256 Zy, __m256 Zx2, __m256 Zy2, __m256 Cx, __m256 Cy, __m256& newZx, __m256& newZy)
+{
+	const __m256 two = _mm256_set1_ps(2.0f);
+	if (Power == 2)
+	{
+		newZy = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, Zx), Zy), Cy);
+		newZx = _mm256_add_ps(_mm256_sub_ps(Zx2, Zy2), Cx);
+		return;
+	}
+	__m256 Px = _mm256_sub_ps(Zx2, Zy2);
+	__m256 Py = _mm256_mul_ps(_mm256_mul_ps(two, Zx), Zy);
+	for (int p = 2; p < Power; p++)
+	{
+		__m256 nextPx = _mm256_sub_ps(_mm256_mul_ps(Px, Zx), _mm256_mul_ps(Py, Zy));
+		Py = _mm256_add_ps(_mm256_mul_ps(Px, Zy), _mm256_mul_ps(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = _mm256_add_ps(Px, Cx);
+	newZy = _mm256_add_ps(Py, Cy);
+}
+
+// 8 pixels at a time, escaped lanes are masked out and keep their last Z
+// same operation order as the scalar version, so results only differ if the compiler contracts mul/add to FMA
+// (or when periodicity is detected at a different iteration, the result is inside anyway)
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+void	iterationLineAVX2(float startCx, float startCy, float Dx, float Dy, float juliaCx, float juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m256 ER2 = _mm256_set1_ps(4.0f);
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 sixteenth = _mm256_set1_ps(0.0625f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 tolerance2 = _mm256_set1_ps(PeriodicityTolerance2);
+	const __m256i maxIteration = _mm256_set1_epi32(iterationMax);
+	const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 vStartCx = _mm256_set1_ps(startCx);
+	const __m256 vStartCy = _mm256_set1_ps(startCy);
+	const __m256 vDx = _mm256_set1_ps(Dx);
+	const __m256 vDy = _mm256_set1_ps(Dy);
+	const __m256 vJuliaCx = _mm256_set1_ps(juliaCx);
+	const __m256 vJuliaCy = _mm256_set1_ps(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+		__m256 Zx = _mm256_add_ps(vStartCx, _mm256_mul_ps(index, vDx));
+		__m256 Zy = _mm256_add_ps(vStartCy, _mm256_mul_ps(index, vDy));
+		__m256 Cxv = Julia ? vJuliaCx : Zx;
+		__m256 Cyv = Julia ? vJuliaCy : Zy;
+		__m256 Zx2 = _mm256_mul_ps(Zx, Zx);
+		__m256 Zy2 = _mm256_mul_ps(Zy, Zy);
+		__m256i Iteration = _mm256_setzero_si256();
+		__m256 active = _mm256_cmp_ps(_mm256_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__m256 inside = _mm256_setzero_ps();
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m256 xq = _mm256_sub_ps(Cxv, quarter);
+			__m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), Zy2);
+			__m256 inCardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)), _mm256_mul_ps(quarter, Zy2), _CMP_LT_OQ);
+			__m256 x1 = _mm256_add_ps(Cxv, one);
+			__m256 inBulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			inside = _mm256_or_ps(inCardioid, inBulb);
+			active = _mm256_andnot_ps(inside, active);
+		}
+
+		__m256 Sx = Zx;
+		__m256 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; it < iterationMax; it++)
+		{
+			if (_mm256_movemask_ps(active) == 0)
+			{
+				break;
+			}
+			__m256 newZx, newZy;
+			formulaStepAVX2<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm256_blendv_ps(Zx, newZx, active);
+			Zy = _mm256_blendv_ps(Zy, newZy, active);
+			Zx2 = _mm256_mul_ps(Zx, Zx);
+			Zy2 = _mm256_mul_ps(Zy, Zy);
+			// active lanes are all ones (-1), so subtract to increment
+			Iteration = _mm256_sub_epi32(Iteration, _mm256_castps_si256(active));
+			active = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ));
+
+			if (checkPeriodicity)
+			{
+				__m256 dx = _mm256_sub_ps(Zx, Sx);
+				__m256 dy = _mm256_sub_ps(Zy, Sy);
+				__m256 periodic = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), tolerance2, _CMP_LT_OQ));
+				inside = _mm256_or_ps(inside, periodic);
+				active = _mm256_andnot_ps(periodic, active);
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(Iteration), _mm256_castsi256_ps(maxIteration), inside));
+		checkPeriodicity = (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(Iteration, maxIteration))) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), Iteration);
+		_mm256_storeu_ps(outZx + i, Zx);
+		_mm256_storeu_ps(outZy + i, Zy);
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+template<int Power>
+MANDELBROT_TARGET("avx512f")
+inline void	formulaStepAVX512(__m512 Zx, __m512 Zy, __m512 Zx2, __m512 Zy2, __m512 Cx, __m512 Cy, __m512& newZx, __m512& newZy)
+{
+	const __m512 two = _mm512_set1_ps(2.0f);
+	if (Power == 2)
+	{
+		newZy = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, Zx), Zy), Cy);
+		newZx = _mm512_add_ps(_mm512_sub_ps(Zx2, Zy2), Cx);
+		return;
+	}
+	__m512 Px = _mm512_sub_ps(Zx2, Zy2);
+	__m512 Py = _mm512_mul_ps(_mm512_mul_ps(two, Zx), Zy);
+	for (int p = 2; p < Power; p++)
+	{
+		__m512 nextPx = _mm512_sub_ps(_mm512_mul_ps(Px, Zx), _mm512_mul_ps(Py, Zy));
+		Py = _mm512_add_ps(_mm512_mul_ps(Px, Zy), _mm512_mul_ps(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = _mm512_add_ps(Px, Cx);
+	newZy = _mm512_add_ps(Py, Cy);
+}
+
+// 16 pixels at a time using mask registers
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+void	iterationLineAVX512(float startCx, float startCy, float Dx, float Dy, float juliaCx, float juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m512 ER2 = _mm512_set1_ps(4.0f);
+	const __m512 quarter = _mm512_set1_ps(0.25f);
+	const __m512 sixteenth = _mm512_set1_ps(0.0625f);
+	const __m512 onef = _mm512_set1_ps(1.0f);
+	const __m512 tolerance2 = _mm512_set1_ps(PeriodicityTolerance2);
+	const __m512i maxIteration = _mm512_set1_epi32(iterationMax);
+	const __m512 lanes = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+	const __m512 vStartCx = _mm512_set1_ps(startCx);
+	const __m512 vStartCy = _mm512_set1_ps(startCy);
+	const __m512 vDx = _mm512_set1_ps(Dx);
+	const __m512 vDy = _mm512_set1_ps(Dy);
+	const __m512 vJuliaCx = _mm512_set1_ps(juliaCx);
+	const __m512 vJuliaCy = _mm512_set1_ps(juliaCy);
+	const __m512i one = _mm512_set1_epi32(1);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 index = _mm512_add_ps(_mm512_set1_ps((float)i), lanes);
+		__m512 Zx = _mm512_add_ps(vStartCx, _mm512_mul_ps(index, vDx));
+		__m512 Zy = _mm512_add_ps(vStartCy, _mm512_mul_ps(index, vDy));
+		__m512 Cxv = Julia ? vJuliaCx : Zx;
+		__m512 Cyv = Julia ? vJuliaCy : Zy;
+		__m512 Zx2 = _mm512_mul_ps(Zx, Zx);
+		__m512 Zy2 = _mm512_mul_ps(Zy, Zy);
+		__m512i Iteration = _mm512_setzero_si512();
+		__mmask16 active = _mm512_cmp_ps_mask(_mm512_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__mmask16 inside = 0;
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m512 xq = _mm512_sub_ps(Cxv, quarter);
+			__m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), Zy2);
+			inside = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)), _mm512_mul_ps(quarter, Zy2), _CMP_LT_OQ);
+			__m512 x1 = _mm512_add_ps(Cxv, onef);
+			inside |= _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		__m512 Sx = Zx;
+		__m512 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; (it < iterationMax) && active; it++)
+		{
+			__m512 newZx, newZy;
+			formulaStepAVX512<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm512_mask_blend_ps(active, Zx, newZx);
+			Zy = _mm512_mask_blend_ps(active, Zy, newZy);
+			Zx2 = _mm512_mul_ps(Zx, Zx);
+			Zy2 = _mm512_mul_ps(Zy, Zy);
+			Iteration = _mm512_mask_add_epi32(Iteration, active, Iteration, one);
+			active = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+
+			if (checkPeriodicity)
+			{
+				__m512 dx = _mm512_sub_ps(Zx, Sx);
+				__m512 dy = _mm512_sub_ps(Zy, Sy);
+				__mmask16 periodic = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), tolerance2, _CMP_LT_OQ);
+				inside |= periodic;
+				active &= ~periodic;
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm512_mask_mov_epi32(Iteration, inside, maxIteration);
+		checkPeriodicity = (_mm512_cmpeq_epi32_mask(Iteration, maxIteration) != 0);
+
+		_mm512_storeu_si512((void*)(iterations + i), Iteration);
+		_mm512_storeu_ps(outZx + i, Zx);
+		_mm512_storeu_ps(outZy + i, Zy);
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+
+template<int Power>
+MANDELBROT_TARGET("avx2")
+inline void	formulaStepDoubleAVX2(__m256d Zx, __m256d Zy, __m256d Zx2, __m256d Zy2, __m256d Cx, __m256d Cy, __m256d& newZx, __m256d& newZy)
+{
+	const __m256d two = _mm256_set1_pd(2.0);
+	if (Power == 2)
+	{
+		newZy = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, Zx), Zy), Cy);
+		newZx = _mm256_add_pd(_mm256_sub_pd(Zx2, Zy2), Cx);
+		return;
+	}
+	__m256d Px = _mm256_sub_pd(Zx2, Zy2);
+	__m256d Py = _mm256_mul_pd(_mm256_mul_pd(two, Zx), Zy);
+	for (int p = 2; p < Power; p++)
+	{
+		__m256d nextPx = _mm256_sub_pd(_mm256_mul_pd(Px, Zx), _mm256_mul_pd(Py, Zy));
+		Py = _mm256_add_pd(_mm256_mul_pd(Px, Zy), _mm256_mul_pd(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = _mm256_add_pd(Px, Cx);
+	newZy = _mm256_add_pd(Py, Cy);
+}
+
+// double precision, 4 pixels at a time : same as the float kernel, iteration counts are kept as doubles
+// so they use the same lanes as Z
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+void	iterationLineDoubleAVX2(double startCx, double startCy, double Dx, double Dy, double juliaCx, double juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m256d ER2 = _mm256_set1_pd(4.0);
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d sixteenth = _mm256_set1_pd(0.0625);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d tolerance2 = _mm256_set1_pd(periodicityTolerance2(Dx, Dy));
+	const __m256d maxIteration = _mm256_set1_pd((double)iterationMax);
+	const __m256d lanes = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+	const __m256d vStartCx = _mm256_set1_pd(startCx);
+	const __m256d vStartCy = _mm256_set1_pd(startCy);
+	const __m256d vDx = _mm256_set1_pd(Dx);
+	const __m256d vDy = _mm256_set1_pd(Dy);
+	const __m256d vJuliaCx = _mm256_set1_pd(juliaCx);
+	const __m256d vJuliaCy = _mm256_set1_pd(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d index = _mm256_add_pd(_mm256_set1_pd((double)i), lanes);
+		__m256d Zx = _mm256_add_pd(vStartCx, _mm256_mul_pd(index, vDx));
+		__m256d Zy = _mm256_add_pd(vStartCy, _mm256_mul_pd(index, vDy));
+		__m256d Cxv = Julia ? vJuliaCx : Zx;
+		__m256d Cyv = Julia ? vJuliaCy : Zy;
+		__m256d Zx2 = _mm256_mul_pd(Zx, Zx);
+		__m256d Zy2 = _mm256_mul_pd(Zy, Zy);
+		__m256d Iteration = _mm256_setzero_pd();
+		__m256d active = _mm256_cmp_pd(_mm256_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__m256d inside = _mm256_setzero_pd();
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m256d xq = _mm256_sub_pd(Cxv, quarter);
+			__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), Zy2);
+			__m256d inCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), _mm256_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m256d x1 = _mm256_add_pd(Cxv, one);
+			__m256d inBulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			inside = _mm256_or_pd(inCardioid, inBulb);
+			active = _mm256_andnot_pd(inside, active);
+		}
+
+		__m256d Sx = Zx;
+		__m256d Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; it < iterationMax; it++)
+		{
+			if (_mm256_movemask_pd(active) == 0)
+			{
+				break;
+			}
+			__m256d newZx, newZy;
+			formulaStepDoubleAVX2<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm256_blendv_pd(Zx, newZx, active);
+			Zy = _mm256_blendv_pd(Zy, newZy, active);
+			Zx2 = _mm256_mul_pd(Zx, Zx);
+			Zy2 = _mm256_mul_pd(Zy, Zy);
+			Iteration = _mm256_add_pd(Iteration, _mm256_and_pd(active, one));
+			active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ));
+
+			if (checkPeriodicity)
+			{
+				__m256d dx = _mm256_sub_pd(Zx, Sx);
+				__m256d dy = _mm256_sub_pd(Zy, Sy);
+				__m256d periodic = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ));
+				inside = _mm256_or_pd(inside, periodic);
+				active = _mm256_andnot_pd(periodic, active);
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm256_blendv_pd(Iteration, maxIteration, inside);
+		checkPeriodicity = (_mm256_movemask_pd(_mm256_cmp_pd(Iteration, maxIteration, _CMP_EQ_OQ)) != 0);
+
+		_mm_storeu_si128((__m128i*)(iterations + i), _mm256_cvtpd_epi32(Iteration));
+		_mm_storeu_ps(outZx + i, _mm256_cvtpd_ps(Zx));
+		_mm_storeu_ps(outZy + i, _mm256_cvtpd_ps(Zy));
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+template<int Power>
+MANDELBROT_TARGET("avx512f")
+inline void	formulaStepDoubleAVX512(__m512d Zx, __m512d Zy, __m512d Zx2, __m512d Zy2, __m512d Cx, __m512d Cy, __m512d& newZx, __m512d& newZy)
+{
+	const __m512d two = _mm512_set1_pd(2.0);
+	if (Power == 2)
+	{
+		newZy = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, Zx), Zy), Cy);
+		newZx = _mm512_add_pd(_mm512_sub_pd(Zx2, Zy2), Cx);
+		return;
+	}
+	__m512d Px = _mm512_sub_pd(Zx2, Zy2);
+	__m512d Py = _mm512_mul_pd(_mm512_mul_pd(two, Zx), Zy);
+	for (int p = 2; p < Power; p++)
+	{
+		__m512d nextPx = _mm512_sub_pd(_mm512_mul_pd(Px, Zx), _mm512_mul_pd(Py, Zy));
+		Py = _mm512_add_pd(_mm512_mul_pd(Px, Zy), _mm512_mul_pd(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = _mm512_add_pd(Px, Cx);
+	newZy = _mm512_add_pd(Py, Cy);
+}
+
+// double precision, 8 pixels at a time using mask registers
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+void	iterationLineDoubleAVX512(double startCx, double startCy, double Dx, double Dy, double juliaCx, double juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m512d ER2 = _mm512_set1_pd(4.0);
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	const __m512d sixteenth = _mm512_set1_pd(0.0625);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d tolerance2 = _mm512_set1_pd(periodicityTolerance2(Dx, Dy));
+	const __m512d maxIteration = _mm512_set1_pd((double)iterationMax);
+	const __m512d lanes = _mm512_setr_pd(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0);
+	const __m512d vStartCx = _mm512_set1_pd(startCx);
+	const __m512d vStartCy = _mm512_set1_pd(startCy);
+	const __m512d vDx = _mm512_set1_pd(Dx);
+	const __m512d vDy = _mm512_set1_pd(Dy);
+	const __m512d vJuliaCx = _mm512_set1_pd(juliaCx);
+	const __m512d vJuliaCy = _mm512_set1_pd(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m512d index = _mm512_add_pd(_mm512_set1_pd((double)i), lanes);
+		__m512d Zx = _mm512_add_pd(vStartCx, _mm512_mul_pd(index, vDx));
+		__m512d Zy = _mm512_add_pd(vStartCy, _mm512_mul_pd(index, vDy));
+		__m512d Cxv = Julia ? vJuliaCx : Zx;
+		__m512d Cyv = Julia ? vJuliaCy : Zy;
+		__m512d Zx2 = _mm512_mul_pd(Zx, Zx);
+		__m512d Zy2 = _mm512_mul_pd(Zy, Zy);
+		__m512d Iteration = _mm512_setzero_pd();
+		__mmask8 active = _mm512_cmp_pd_mask(_mm512_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__mmask8 inside = 0;
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m512d xq = _mm512_sub_pd(Cxv, quarter);
+			__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), Zy2);
+			inside = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)), _mm512_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m512d x1 = _mm512_add_pd(Cxv, one);
+			inside |= _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		__m512d Sx = Zx;
+		__m512d Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; (it < iterationMax) && active; it++)
+		{
+			__m512d newZx, newZy;
+			formulaStepDoubleAVX512<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm512_mask_blend_pd(active, Zx, newZx);
+			Zy = _mm512_mask_blend_pd(active, Zy, newZy);
+			Zx2 = _mm512_mul_pd(Zx, Zx);
+			Zy2 = _mm512_mul_pd(Zy, Zy);
+			Iteration = _mm512_mask_add_pd(Iteration, active, Iteration, one);
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+
+			if (checkPeriodicity)
+			{
+				__m512d dx = _mm512_sub_pd(Zx, Sx);
+				__m512d dy = _mm512_sub_pd(Zy, Sy);
+				__mmask8 periodic = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ);
+				inside |= periodic;
+				active &= ~periodic;
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm512_mask_mov_pd(Iteration, inside, maxIteration);
+		checkPeriodicity = (_mm512_cmp_pd_mask(Iteration, maxIteration, _CMP_EQ_OQ) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), _mm512_cvtpd_epi32(Iteration));
+		_mm256_storeu_ps(outZx + i, _mm512_cvtpd_ps(Zx));
+		_mm256_storeu_ps(outZy + i, _mm512_cvtpd_ps(Zy));
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+// double-double lanes : each value is hi + lo, same operations as Kigs::DoubleDouble
+// but the exact product error comes from FMA instead of a Dekker split
+struct DoubleDouble4
+{
+	__m256d	hi;
+	__m256d	lo;
+};
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4Set(const DoubleDouble& v)
+{
+	DoubleDouble4 result = { _mm256_set1_pd(v.hi), _mm256_set1_pd(v.lo) };
+	return result;
+}
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4QuickTwoSum(__m256d a, __m256d b)
+{
+	__m256d s = _mm256_add_pd(a, b);
+	DoubleDouble4 result = { s, _mm256_sub_pd(b, _mm256_sub_pd(s, a)) };
+	return result;
+}
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4Add(const DoubleDouble4& a, const DoubleDouble4& b)
+{
+	__m256d s = _mm256_add_pd(a.hi, b.hi);
+	__m256d bb = _mm256_sub_pd(s, a.hi);
+	__m256d e = _mm256_add_pd(_mm256_sub_pd(a.hi, _mm256_sub_pd(s, bb)), _mm256_sub_pd(b.hi, bb));
+	return dd4QuickTwoSum(s, _mm256_add_pd(_mm256_add_pd(e, a.lo), b.lo));
+}
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4Sub(const DoubleDouble4& a, const DoubleDouble4& b)
+{
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	DoubleDouble4 minusB = { _mm256_xor_pd(b.hi, sign), _mm256_xor_pd(b.lo, sign) };
+	return dd4Add(a, minusB);
+}
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4Mul(const DoubleDouble4& a, const DoubleDouble4& b)
+{
+	__m256d p = _mm256_mul_pd(a.hi, b.hi);
+	__m256d e = _mm256_fmsub_pd(a.hi, b.hi, p);
+	return dd4QuickTwoSum(p, _mm256_add_pd(e, _mm256_add_pd(_mm256_mul_pd(a.hi, b.lo), _mm256_mul_pd(a.lo, b.hi))));
+}
+
+MANDELBROT_TARGET("avx2,fma")
+inline DoubleDouble4	dd4Blend(const DoubleDouble4& a, const DoubleDouble4& b, __m256d mask)
+{
+	DoubleDouble4 result = { _mm256_blendv_pd(a.hi, b.hi, mask), _mm256_blendv_pd(a.lo, b.lo, mask) };
+	return result;
+}
+
+template<int Power>
+MANDELBROT_TARGET("avx2,fma")
+inline void	formulaStepDoubleDoubleAVX2(const DoubleDouble4& Zx, const DoubleDouble4& Zy, const DoubleDouble4& Zx2, const DoubleDouble4& Zy2, const DoubleDouble4& Cx, const DoubleDouble4& Cy, DoubleDouble4& newZx, DoubleDouble4& newZy)
+{
+	DoubleDouble4 ZxZy = dd4Mul(Zx, Zy);
+	if (Power == 2)
+	{
+		newZy = dd4Add(dd4Add(ZxZy, ZxZy), Cy);
+		newZx = dd4Add(dd4Sub(Zx2, Zy2), Cx);
+		return;
+	}
+	DoubleDouble4 Px = dd4Sub(Zx2, Zy2);
+	DoubleDouble4 Py = dd4Add(ZxZy, ZxZy);
+	for (int p = 2; p < Power; p++)
+	{
+		DoubleDouble4 nextPx = dd4Sub(dd4Mul(Px, Zx), dd4Mul(Py, Zy));
+		Py = dd4Add(dd4Mul(Px, Zy), dd4Mul(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = dd4Add(Px, Cx);
+	newZy = dd4Add(Py, Cy);
+}
+
+// double-double, 4 pixels at a time
+// escape and cardioid tests only need the high parts, periodicity distance uses both parts
+// (saved and current points are close, so the difference of high parts is exact)
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2,fma")
+void	iterationLineDoubleDoubleAVX2(DoubleDouble startCx, DoubleDouble startCy, DoubleDouble Dx, DoubleDouble Dy, DoubleDouble juliaCx, DoubleDouble juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m256d ER2 = _mm256_set1_pd(4.0);
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d sixteenth = _mm256_set1_pd(0.0625);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d tolerance2 = _mm256_set1_pd(periodicityTolerance2(Dx, Dy).hi);
+	const __m256d maxIteration = _mm256_set1_pd((double)iterationMax);
+	const __m256d lanes = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+	const DoubleDouble4 vStartCx = dd4Set(startCx);
+	const DoubleDouble4 vStartCy = dd4Set(startCy);
+	const DoubleDouble4 vDx = dd4Set(Dx);
+	const DoubleDouble4 vDy = dd4Set(Dy);
+	const DoubleDouble4 vJuliaCx = dd4Set(juliaCx);
+	const DoubleDouble4 vJuliaCy = dd4Set(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		DoubleDouble4 index = { _mm256_add_pd(_mm256_set1_pd((double)i), lanes), _mm256_setzero_pd() };
+		DoubleDouble4 Zx = dd4Add(vStartCx, dd4Mul(index, vDx));
+		DoubleDouble4 Zy = dd4Add(vStartCy, dd4Mul(index, vDy));
+		DoubleDouble4 Cx = Julia ? vJuliaCx : Zx;
+		DoubleDouble4 Cy = Julia ? vJuliaCy : Zy;
+		DoubleDouble4 Zx2 = dd4Mul(Zx, Zx);
+		DoubleDouble4 Zy2 = dd4Mul(Zy, Zy);
+		__m256d Iteration = _mm256_setzero_pd();
+		__m256d active = _mm256_cmp_pd(_mm256_add_pd(Zx2.hi, Zy2.hi), ER2, _CMP_LT_OQ);
+		__m256d inside = _mm256_setzero_pd();
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m256d xq = _mm256_sub_pd(Cx.hi, quarter);
+			__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), Zy2.hi);
+			__m256d inCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), _mm256_mul_pd(quarter, Zy2.hi), _CMP_LT_OQ);
+			__m256d x1 = _mm256_add_pd(Cx.hi, one);
+			__m256d inBulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), Zy2.hi), sixteenth, _CMP_LT_OQ);
+			inside = _mm256_or_pd(inCardioid, inBulb);
+			active = _mm256_andnot_pd(inside, active);
+		}
+
+		DoubleDouble4 Sx = Zx;
+		DoubleDouble4 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; it < iterationMax; it++)
+		{
+			if (_mm256_movemask_pd(active) == 0)
+			{
+				break;
+			}
+			DoubleDouble4 newZx, newZy;
+			formulaStepDoubleDoubleAVX2<Power>(Zx, Zy, Zx2, Zy2, Cx, Cy, newZx, newZy);
+			Zx = dd4Blend(Zx, newZx, active);
+			Zy = dd4Blend(Zy, newZy, active);
+			Zx2 = dd4Mul(Zx, Zx);
+			Zy2 = dd4Mul(Zy, Zy);
+			Iteration = _mm256_add_pd(Iteration, _mm256_and_pd(active, one));
+			active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(Zx2.hi, Zy2.hi), ER2, _CMP_LT_OQ));
+
+			if (checkPeriodicity)
+			{
+				__m256d dx = _mm256_add_pd(_mm256_sub_pd(Zx.hi, Sx.hi), _mm256_sub_pd(Zx.lo, Sx.lo));
+				__m256d dy = _mm256_add_pd(_mm256_sub_pd(Zy.hi, Sy.hi), _mm256_sub_pd(Zy.lo, Sy.lo));
+				__m256d periodic = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ));
+				inside = _mm256_or_pd(inside, periodic);
+				active = _mm256_andnot_pd(periodic, active);
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm256_blendv_pd(Iteration, maxIteration, inside);
+		checkPeriodicity = (_mm256_movemask_pd(_mm256_cmp_pd(Iteration, maxIteration, _CMP_EQ_OQ)) != 0);
+
+		_mm_storeu_si128((__m128i*)(iterations + i), _mm256_cvtpd_epi32(Iteration));
+		_mm_storeu_ps(outZx + i, _mm256_cvtpd_ps(Zx.hi));
+		_mm_storeu_ps(outZy + i, _mm256_cvtpd_ps(Zy.hi));
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+struct DoubleDouble8
+{
+	__m512d	hi;
+	__m512d	lo;
+};
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8Set(const DoubleDouble& v)
+{
+	DoubleDouble8 result = { _mm512_set1_pd(v.hi), _mm512_set1_pd(v.lo) };
+	return result;
+}
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8QuickTwoSum(__m512d a, __m512d b)
+{
+	__m512d s = _mm512_add_pd(a, b);
+	DoubleDouble8 result = { s, _mm512_sub_pd(b, _mm512_sub_pd(s, a)) };
+	return result;
+}
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8Add(const DoubleDouble8& a, const DoubleDouble8& b)
+{
+	__m512d s = _mm512_add_pd(a.hi, b.hi);
+	__m512d bb = _mm512_sub_pd(s, a.hi);
+	__m512d e = _mm512_add_pd(_mm512_sub_pd(a.hi, _mm512_sub_pd(s, bb)), _mm512_sub_pd(b.hi, bb));
+	return dd8QuickTwoSum(s, _mm512_add_pd(_mm512_add_pd(e, a.lo), b.lo));
+}
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8Sub(const DoubleDouble8& a, const DoubleDouble8& b)
+{
+	DoubleDouble8 minusB = { _mm512_sub_pd(_mm512_setzero_pd(), b.hi), _mm512_sub_pd(_mm512_setzero_pd(), b.lo) };
+	return dd8Add(a, minusB);
+}
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8Mul(const DoubleDouble8& a, const DoubleDouble8& b)
+{
+	__m512d p = _mm512_mul_pd(a.hi, b.hi);
+	__m512d e = _mm512_fmsub_pd(a.hi, b.hi, p);
+	return dd8QuickTwoSum(p, _mm512_add_pd(e, _mm512_add_pd(_mm512_mul_pd(a.hi, b.lo), _mm512_mul_pd(a.lo, b.hi))));
+}
+
+MANDELBROT_TARGET("avx512f")
+inline DoubleDouble8	dd8Blend(__mmask8 mask, const DoubleDouble8& a, const DoubleDouble8& b)
+{
+	DoubleDouble8 result = { _mm512_mask_blend_pd(mask, a.hi, b.hi), _mm512_mask_blend_pd(mask, a.lo, b.lo) };
+	return result;
+}
+
+template<int Power>
+MANDELBROT_TARGET("avx512f")
+inline void	formulaStepDoubleDoubleAVX512(const DoubleDouble8& Zx, const DoubleDouble8& Zy, const DoubleDouble8& Zx2, const DoubleDouble8& Zy2, const DoubleDouble8& Cx, const DoubleDouble8& Cy, DoubleDouble8& newZx, DoubleDouble8& newZy)
+{
+	DoubleDouble8 ZxZy = dd8Mul(Zx, Zy);
+	if (Power == 2)
+	{
+		newZy = dd8Add(dd8Add(ZxZy, ZxZy), Cy);
+		newZx = dd8Add(dd8Sub(Zx2, Zy2), Cx);
+		return;
+	}
+	DoubleDouble8 Px = dd8Sub(Zx2, Zy2);
+	DoubleDouble8 Py = dd8Add(ZxZy, ZxZy);
+	for (int p = 2; p < Power; p++)
+	{
+		DoubleDouble8 nextPx = dd8Sub(dd8Mul(Px, Zx), dd8Mul(Py, Zy));
+		Py = dd8Add(dd8Mul(Px, Zy), dd8Mul(Py, Zx));
+		Px = nextPx;
+	}
+	newZx = dd8Add(Px, Cx);
+	newZy = dd8Add(Py, Cy);
+}
+
+// double-double, 8 pixels at a time using mask registers
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+void	iterationLineDoubleDoubleAVX512(DoubleDouble startCx, DoubleDouble startCy, DoubleDouble Dx, DoubleDouble Dy, DoubleDouble juliaCx, DoubleDouble juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy)
+{
+	const __m512d ER2 = _mm512_set1_pd(4.0);
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	const __m512d sixteenth = _mm512_set1_pd(0.0625);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d tolerance2 = _mm512_set1_pd(periodicityTolerance2(Dx, Dy).hi);
+	const __m512d maxIteration = _mm512_set1_pd((double)iterationMax);
+	const __m512d lanes = _mm512_setr_pd(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0);
+	const DoubleDouble8 vStartCx = dd8Set(startCx);
+	const DoubleDouble8 vStartCy = dd8Set(startCy);
+	const DoubleDouble8 vDx = dd8Set(Dx);
+	const DoubleDouble8 vDy = dd8Set(Dy);
+	const DoubleDouble8 vJuliaCx = dd8Set(juliaCx);
+	const DoubleDouble8 vJuliaCy = dd8Set(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		DoubleDouble8 index = { _mm512_add_pd(_mm512_set1_pd((double)i), lanes), _mm512_setzero_pd() };
+		DoubleDouble8 Zx = dd8Add(vStartCx, dd8Mul(index, vDx));
+		DoubleDouble8 Zy = dd8Add(vStartCy, dd8Mul(index, vDy));
+		DoubleDouble8 Cx = Julia ? vJuliaCx : Zx;
+		DoubleDouble8 Cy = Julia ? vJuliaCy : Zy;
+		DoubleDouble8 Zx2 = dd8Mul(Zx, Zx);
+		DoubleDouble8 Zy2 = dd8Mul(Zy, Zy);
+		__m512d Iteration = _mm512_setzero_pd();
+		__mmask8 active = _mm512_cmp_pd_mask(_mm512_add_pd(Zx2.hi, Zy2.hi), ER2, _CMP_LT_OQ);
+		__mmask8 inside = 0;
+
+		// main cardioid and period 2 bulb lanes are inside without iterating
+		if (!Julia && (Power == 2))
+		{
+			__m512d xq = _mm512_sub_pd(Cx.hi, quarter);
+			__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), Zy2.hi);
+			inside = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)), _mm512_mul_pd(quarter, Zy2.hi), _CMP_LT_OQ);
+			__m512d x1 = _mm512_add_pd(Cx.hi, one);
+			inside |= _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x1, x1), Zy2.hi), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		DoubleDouble8 Sx = Zx;
+		DoubleDouble8 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; (it < iterationMax) && active; it++)
+		{
+			DoubleDouble8 newZx, newZy;
+			formulaStepDoubleDoubleAVX512<Power>(Zx, Zy, Zx2, Zy2, Cx, Cy, newZx, newZy);
+			Zx = dd8Blend(active, Zx, newZx);
+			Zy = dd8Blend(active, Zy, newZy);
+			Zx2 = dd8Mul(Zx, Zx);
+			Zy2 = dd8Mul(Zy, Zy);
+			Iteration = _mm512_mask_add_pd(Iteration, active, Iteration, one);
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(Zx2.hi, Zy2.hi), ER2, _CMP_LT_OQ);
+
+			if (checkPeriodicity)
+			{
+				__m512d dx = _mm512_add_pd(_mm512_sub_pd(Zx.hi, Sx.hi), _mm512_sub_pd(Zx.lo, Sx.lo));
+				__m512d dy = _mm512_add_pd(_mm512_sub_pd(Zy.hi, Sy.hi), _mm512_sub_pd(Zy.lo, Sy.lo));
+				__mmask8 periodic = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ);
+				inside |= periodic;
+				active &= ~periodic;
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm512_mask_mov_pd(Iteration, inside, maxIteration);
+		checkPeriodicity = (_mm512_cmp_pd_mask(Iteration, maxIteration, _CMP_EQ_OQ) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), _mm512_cvtpd_epi32(Iteration));
+		_mm256_storeu_ps(outZx + i, _mm512_cvtpd_ps(Zx.hi));
+		_mm256_storeu_ps(outZy + i, _mm512_cvtpd_ps(Zy.hi));
+	}
+	iterationLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy);
+}
+
+// distance estimation versions of the float and double kernels : dZ is iterated and blended like Z,
+// distances are computed per lane once all orbits of the lanes are done (one log per pixel, outside the iteration loop)
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+inline void	derivativeStepAVX2(__m256 Zx, __m256 Zy, __m256 dZx, __m256 dZy, __m256& newdZx, __m256& newdZy)
+{
+	__m256 Qx = Zx;
+	__m256 Qy = Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		__m256 nextQx = _mm256_sub_ps(_mm256_mul_ps(Qx, Zx), _mm256_mul_ps(Qy, Zy));
+		Qy = _mm256_add_ps(_mm256_mul_ps(Qx, Zy), _mm256_mul_ps(Qy, Zx));
+		Qx = nextQx;
+	}
+	const __m256 power = _mm256_set1_ps((float)Power);
+	Qx = _mm256_mul_ps(power, Qx);
+	Qy = _mm256_mul_ps(power, Qy);
+	__m256 resultX = _mm256_sub_ps(_mm256_mul_ps(Qx, dZx), _mm256_mul_ps(Qy, dZy));
+	newdZy = _mm256_add_ps(_mm256_mul_ps(Qx, dZy), _mm256_mul_ps(Qy, dZx));
+	newdZx = Julia ? resultX : _mm256_add_ps(resultX, _mm256_set1_ps(1.0f));
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+void	distanceLineAVX2(float startCx, float startCy, float Dx, float Dy, float juliaCx, float juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy, float* outDistance)
+{
+	const __m256 ER2 = _mm256_set1_ps((float)MandelbrotDistanceEscapeRadius2);
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 sixteenth = _mm256_set1_ps(0.0625f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 tolerance2 = _mm256_set1_ps(PeriodicityTolerance2);
+	const __m256i maxIteration = _mm256_set1_epi32(iterationMax);
+	const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 vStartCx = _mm256_set1_ps(startCx);
+	const __m256 vStartCy = _mm256_set1_ps(startCy);
+	const __m256 vDx = _mm256_set1_ps(Dx);
+	const __m256 vDy = _mm256_set1_ps(Dy);
+	const __m256 vJuliaCx = _mm256_set1_ps(juliaCx);
+	const __m256 vJuliaCy = _mm256_set1_ps(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+		__m256 Zx = _mm256_add_ps(vStartCx, _mm256_mul_ps(index, vDx));
+		__m256 Zy = _mm256_add_ps(vStartCy, _mm256_mul_ps(index, vDy));
+		__m256 Cxv = Julia ? vJuliaCx : Zx;
+		__m256 Cyv = Julia ? vJuliaCy : Zy;
+		__m256 Zx2 = _mm256_mul_ps(Zx, Zx);
+		__m256 Zy2 = _mm256_mul_ps(Zy, Zy);
+		__m256 dZx = one;
+		__m256 dZy = _mm256_setzero_ps();
+		__m256i Iteration = _mm256_setzero_si256();
+		__m256 active = _mm256_cmp_ps(_mm256_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__m256 inside = _mm256_setzero_ps();
+
+		if (!Julia && (Power == 2))
+		{
+			__m256 xq = _mm256_sub_ps(Cxv, quarter);
+			__m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), Zy2);
+			__m256 inCardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)), _mm256_mul_ps(quarter, Zy2), _CMP_LT_OQ);
+			__m256 x1 = _mm256_add_ps(Cxv, one);
+			__m256 inBulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			inside = _mm256_or_ps(inCardioid, inBulb);
+			active = _mm256_andnot_ps(inside, active);
+		}
+
+		__m256 Sx = Zx;
+		__m256 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; it < iterationMax; it++)
+		{
+			if (_mm256_movemask_ps(active) == 0)
+			{
+				break;
+			}
+			__m256 newZx, newZy, newdZx, newdZy;
+			derivativeStepAVX2<Power, Julia>(Zx, Zy, dZx, dZy, newdZx, newdZy);
+			formulaStepAVX2<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm256_blendv_ps(Zx, newZx, active);
+			Zy = _mm256_blendv_ps(Zy, newZy, active);
+			dZx = _mm256_blendv_ps(dZx, newdZx, active);
+			dZy = _mm256_blendv_ps(dZy, newdZy, active);
+			Zx2 = _mm256_mul_ps(Zx, Zx);
+			Zy2 = _mm256_mul_ps(Zy, Zy);
+			Iteration = _mm256_sub_epi32(Iteration, _mm256_castps_si256(active));
+			active = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ));
+
+			if (checkPeriodicity)
+			{
+				__m256 dx = _mm256_sub_ps(Zx, Sx);
+				__m256 dy = _mm256_sub_ps(Zy, Sy);
+				__m256 periodic = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), tolerance2, _CMP_LT_OQ));
+				inside = _mm256_or_ps(inside, periodic);
+				active = _mm256_andnot_ps(periodic, active);
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(Iteration), _mm256_castsi256_ps(maxIteration), inside));
+		checkPeriodicity = (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(Iteration, maxIteration))) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), Iteration);
+		_mm256_storeu_ps(outZx + i, Zx);
+		_mm256_storeu_ps(outZy + i, Zy);
+
+		float lanedZx[8], lanedZy[8];
+		_mm256_storeu_ps(lanedZx, dZx);
+		_mm256_storeu_ps(lanedZy, dZy);
+		for (int k = 0; k < 8; k++)
+		{
+			outDistance[i + k] = (iterations[i + k] < iterationMax) ? distanceEstimate(outZx[i + k], outZy[i + k], lanedZx[k], lanedZy[k]) : 0.0f;
+		}
+	}
+	distanceLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy, outDistance);
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+inline void	derivativeStepAVX512(__m512 Zx, __m512 Zy, __m512 dZx, __m512 dZy, __m512& newdZx, __m512& newdZy)
+{
+	__m512 Qx = Zx;
+	__m512 Qy = Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		__m512 nextQx = _mm512_sub_ps(_mm512_mul_ps(Qx, Zx), _mm512_mul_ps(Qy, Zy));
+		Qy = _mm512_add_ps(_mm512_mul_ps(Qx, Zy), _mm512_mul_ps(Qy, Zx));
+		Qx = nextQx;
+	}
+	const __m512 power = _mm512_set1_ps((float)Power);
+	Qx = _mm512_mul_ps(power, Qx);
+	Qy = _mm512_mul_ps(power, Qy);
+	__m512 resultX = _mm512_sub_ps(_mm512_mul_ps(Qx, dZx), _mm512_mul_ps(Qy, dZy));
+	newdZy = _mm512_add_ps(_mm512_mul_ps(Qx, dZy), _mm512_mul_ps(Qy, dZx));
+	newdZx = Julia ? resultX : _mm512_add_ps(resultX, _mm512_set1_ps(1.0f));
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+void	distanceLineAVX512(float startCx, float startCy, float Dx, float Dy, float juliaCx, float juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy, float* outDistance)
+{
+	const __m512 ER2 = _mm512_set1_ps((float)MandelbrotDistanceEscapeRadius2);
+	const __m512 quarter = _mm512_set1_ps(0.25f);
+	const __m512 sixteenth = _mm512_set1_ps(0.0625f);
+	const __m512 onef = _mm512_set1_ps(1.0f);
+	const __m512 tolerance2 = _mm512_set1_ps(PeriodicityTolerance2);
+	const __m512i maxIteration = _mm512_set1_epi32(iterationMax);
+	const __m512 lanes = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+	const __m512 vStartCx = _mm512_set1_ps(startCx);
+	const __m512 vStartCy = _mm512_set1_ps(startCy);
+	const __m512 vDx = _mm512_set1_ps(Dx);
+	const __m512 vDy = _mm512_set1_ps(Dy);
+	const __m512 vJuliaCx = _mm512_set1_ps(juliaCx);
+	const __m512 vJuliaCy = _mm512_set1_ps(juliaCy);
+	const __m512i one = _mm512_set1_epi32(1);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 index = _mm512_add_ps(_mm512_set1_ps((float)i), lanes);
+		__m512 Zx = _mm512_add_ps(vStartCx, _mm512_mul_ps(index, vDx));
+		__m512 Zy = _mm512_add_ps(vStartCy, _mm512_mul_ps(index, vDy));
+		__m512 Cxv = Julia ? vJuliaCx : Zx;
+		__m512 Cyv = Julia ? vJuliaCy : Zy;
+		__m512 Zx2 = _mm512_mul_ps(Zx, Zx);
+		__m512 Zy2 = _mm512_mul_ps(Zy, Zy);
+		__m512 dZx = onef;
+		__m512 dZy = _mm512_setzero_ps();
+		__m512i Iteration = _mm512_setzero_si512();
+		__mmask16 active = _mm512_cmp_ps_mask(_mm512_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__mmask16 inside = 0;
+
+		if (!Julia && (Power == 2))
+		{
+			__m512 xq = _mm512_sub_ps(Cxv, quarter);
+			__m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), Zy2);
+			inside = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)), _mm512_mul_ps(quarter, Zy2), _CMP_LT_OQ);
+			__m512 x1 = _mm512_add_ps(Cxv, onef);
+			inside |= _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		__m512 Sx = Zx;
+		__m512 Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; (it < iterationMax) && active; it++)
+		{
+			__m512 newZx, newZy, newdZx, newdZy;
+			derivativeStepAVX512<Power, Julia>(Zx, Zy, dZx, dZy, newdZx, newdZy);
+			formulaStepAVX512<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm512_mask_blend_ps(active, Zx, newZx);
+			Zy = _mm512_mask_blend_ps(active, Zy, newZy);
+			dZx = _mm512_mask_blend_ps(active, dZx, newdZx);
+			dZy = _mm512_mask_blend_ps(active, dZy, newdZy);
+			Zx2 = _mm512_mul_ps(Zx, Zx);
+			Zy2 = _mm512_mul_ps(Zy, Zy);
+			Iteration = _mm512_mask_add_epi32(Iteration, active, Iteration, one);
+			active = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(Zx2, Zy2), ER2, _CMP_LT_OQ);
+
+			if (checkPeriodicity)
+			{
+				__m512 dx = _mm512_sub_ps(Zx, Sx);
+				__m512 dy = _mm512_sub_ps(Zy, Sy);
+				__mmask16 periodic = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), tolerance2, _CMP_LT_OQ);
+				inside |= periodic;
+				active &= ~periodic;
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm512_mask_mov_epi32(Iteration, inside, maxIteration);
+		checkPeriodicity = (_mm512_cmpeq_epi32_mask(Iteration, maxIteration) != 0);
+
+		_mm512_storeu_si512((void*)(iterations + i), Iteration);
+		_mm512_storeu_ps(outZx + i, Zx);
+		_mm512_storeu_ps(outZy + i, Zy);
+
+		float lanedZx[16], lanedZy[16];
+		_mm512_storeu_ps(lanedZx, dZx);
+		_mm512_storeu_ps(lanedZy, dZy);
+		for (int k = 0; k < 16; k++)
+		{
+			outDistance[i + k] = (iterations[i + k] < iterationMax) ? distanceEstimate(outZx[i + k], outZy[i + k], lanedZx[k], lanedZy[k]) : 0.0f;
+		}
+	}
+	distanceLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy, outDistance);
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+inline void	derivativeStepDoubleAVX2(__m256d Zx, __m256d Zy, __m256d dZx, __m256d dZy, __m256d& newdZx, __m256d& newdZy)
+{
+	__m256d Qx = Zx;
+	__m256d Qy = Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		__m256d nextQx = _mm256_sub_pd(_mm256_mul_pd(Qx, Zx), _mm256_mul_pd(Qy, Zy));
+		Qy = _mm256_add_pd(_mm256_mul_pd(Qx, Zy), _mm256_mul_pd(Qy, Zx));
+		Qx = nextQx;
+	}
+	const __m256d power = _mm256_set1_pd((double)Power);
+	Qx = _mm256_mul_pd(power, Qx);
+	Qy = _mm256_mul_pd(power, Qy);
+	__m256d resultX = _mm256_sub_pd(_mm256_mul_pd(Qx, dZx), _mm256_mul_pd(Qy, dZy));
+	newdZy = _mm256_add_pd(_mm256_mul_pd(Qx, dZy), _mm256_mul_pd(Qy, dZx));
+	newdZx = Julia ? resultX : _mm256_add_pd(resultX, _mm256_set1_pd(1.0));
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx2")
+void	distanceLineDoubleAVX2(double startCx, double startCy, double Dx, double Dy, double juliaCx, double juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy, float* outDistance)
+{
+	const __m256d ER2 = _mm256_set1_pd(MandelbrotDistanceEscapeRadius2);
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d sixteenth = _mm256_set1_pd(0.0625);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d tolerance2 = _mm256_set1_pd(periodicityTolerance2(Dx, Dy));
+	const __m256d maxIteration = _mm256_set1_pd((double)iterationMax);
+	const __m256d lanes = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+	const __m256d vStartCx = _mm256_set1_pd(startCx);
+	const __m256d vStartCy = _mm256_set1_pd(startCy);
+	const __m256d vDx = _mm256_set1_pd(Dx);
+	const __m256d vDy = _mm256_set1_pd(Dy);
+	const __m256d vJuliaCx = _mm256_set1_pd(juliaCx);
+	const __m256d vJuliaCy = _mm256_set1_pd(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d index = _mm256_add_pd(_mm256_set1_pd((double)i), lanes);
+		__m256d Zx = _mm256_add_pd(vStartCx, _mm256_mul_pd(index, vDx));
+		__m256d Zy = _mm256_add_pd(vStartCy, _mm256_mul_pd(index, vDy));
+		__m256d Cxv = Julia ? vJuliaCx : Zx;
+		__m256d Cyv = Julia ? vJuliaCy : Zy;
+		__m256d Zx2 = _mm256_mul_pd(Zx, Zx);
+		__m256d Zy2 = _mm256_mul_pd(Zy, Zy);
+		__m256d dZx = one;
+		__m256d dZy = _mm256_setzero_pd();
+		__m256d Iteration = _mm256_setzero_pd();
+		__m256d active = _mm256_cmp_pd(_mm256_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__m256d inside = _mm256_setzero_pd();
+
+		if (!Julia && (Power == 2))
+		{
+			__m256d xq = _mm256_sub_pd(Cxv, quarter);
+			__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), Zy2);
+			__m256d inCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), _mm256_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m256d x1 = _mm256_add_pd(Cxv, one);
+			__m256d inBulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			inside = _mm256_or_pd(inCardioid, inBulb);
+			active = _mm256_andnot_pd(inside, active);
+		}
+
+		__m256d Sx = Zx;
+		__m256d Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; it < iterationMax; it++)
+		{
+			if (_mm256_movemask_pd(active) == 0)
+			{
+				break;
+			}
+			__m256d newZx, newZy, newdZx, newdZy;
+			derivativeStepDoubleAVX2<Power, Julia>(Zx, Zy, dZx, dZy, newdZx, newdZy);
+			formulaStepDoubleAVX2<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm256_blendv_pd(Zx, newZx, active);
+			Zy = _mm256_blendv_pd(Zy, newZy, active);
+			dZx = _mm256_blendv_pd(dZx, newdZx, active);
+			dZy = _mm256_blendv_pd(dZy, newdZy, active);
+			Zx2 = _mm256_mul_pd(Zx, Zx);
+			Zy2 = _mm256_mul_pd(Zy, Zy);
+			Iteration = _mm256_add_pd(Iteration, _mm256_and_pd(active, one));
+			active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ));
+
+			if (checkPeriodicity)
+			{
+				__m256d dx = _mm256_sub_pd(Zx, Sx);
+				__m256d dy = _mm256_sub_pd(Zy, Sy);
+				__m256d periodic = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ));
+				inside = _mm256_or_pd(inside, periodic);
+				active = _mm256_andnot_pd(periodic, active);
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm256_blendv_pd(Iteration, maxIteration, inside);
+		checkPeriodicity = (_mm256_movemask_pd(_mm256_cmp_pd(Iteration, maxIteration, _CMP_EQ_OQ)) != 0);
+
+		_mm_storeu_si128((__m128i*)(iterations + i), _mm256_cvtpd_epi32(Iteration));
+		_mm_storeu_ps(outZx + i, _mm256_cvtpd_ps(Zx));
+		_mm_storeu_ps(outZy + i, _mm256_cvtpd_ps(Zy));
+
+		double laneZx[4], laneZy[4], lanedZx[4], lanedZy[4];
+		_mm256_storeu_pd(laneZx, Zx);
+		_mm256_storeu_pd(laneZy, Zy);
+		_mm256_storeu_pd(lanedZx, dZx);
+		_mm256_storeu_pd(lanedZy, dZy);
+		for (int k = 0; k < 4; k++)
+		{
+			outDistance[i + k] = (iterations[i + k] < iterationMax) ? distanceEstimate(laneZx[k], laneZy[k], lanedZx[k], lanedZy[k]) : 0.0f;
+		}
+	}
+	distanceLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy, outDistance);
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+inline void	derivativeStepDoubleAVX512(__m512d Zx, __m512d Zy, __m512d dZx, __m512d dZy, __m512d& newdZx, __m512d& newdZy)
+{
+	__m512d Qx = Zx;
+	__m512d Qy = Zy;
+	for (int p = 2; p < Power; p++)
+	{
+		__m512d nextQx = _mm512_sub_pd(_mm512_mul_pd(Qx, Zx), _mm512_mul_pd(Qy, Zy));
+		Qy = _mm512_add_pd(_mm512_mul_pd(Qx, Zy), _mm512_mul_pd(Qy, Zx));
+		Qx = nextQx;
+	}
+	const __m512d power = _mm512_set1_pd((double)Power);
+	Qx = _mm512_mul_pd(power, Qx);
+	Qy = _mm512_mul_pd(power, Qy);
+	__m512d resultX = _mm512_sub_pd(_mm512_mul_pd(Qx, dZx), _mm512_mul_pd(Qy, dZy));
+	newdZy = _mm512_add_pd(_mm512_mul_pd(Qx, dZy), _mm512_mul_pd(Qy, dZx));
+	newdZx = Julia ? resultX : _mm512_add_pd(resultX, _mm512_set1_pd(1.0));
+}
+
+template<int Power, bool Julia>
+MANDELBROT_TARGET("avx512f")
+void	distanceLineDoubleAVX512(double startCx, double startCy, double Dx, double Dy, double juliaCx, double juliaCy, int count, int iterationMax, int* iterations, float* outZx, float* outZy, float* outDistance)
+{
+	const __m512d ER2 = _mm512_set1_pd(MandelbrotDistanceEscapeRadius2);
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	const __m512d sixteenth = _mm512_set1_pd(0.0625);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d tolerance2 = _mm512_set1_pd(periodicityTolerance2(Dx, Dy));
+	const __m512d maxIteration = _mm512_set1_pd((double)iterationMax);
+	const __m512d lanes = _mm512_setr_pd(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0);
+	const __m512d vStartCx = _mm512_set1_pd(startCx);
+	const __m512d vStartCy = _mm512_set1_pd(startCy);
+	const __m512d vDx = _mm512_set1_pd(Dx);
+	const __m512d vDy = _mm512_set1_pd(Dy);
+	const __m512d vJuliaCx = _mm512_set1_pd(juliaCx);
+	const __m512d vJuliaCy = _mm512_set1_pd(juliaCy);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m512d index = _mm512_add_pd(_mm512_set1_pd((double)i), lanes);
+		__m512d Zx = _mm512_add_pd(vStartCx, _mm512_mul_pd(index, vDx));
+		__m512d Zy = _mm512_add_pd(vStartCy, _mm512_mul_pd(index, vDy));
+		__m512d Cxv = Julia ? vJuliaCx : Zx;
+		__m512d Cyv = Julia ? vJuliaCy : Zy;
+		__m512d Zx2 = _mm512_mul_pd(Zx, Zx);
+		__m512d Zy2 = _mm512_mul_pd(Zy, Zy);
+		__m512d dZx = one;
+		__m512d dZy = _mm512_setzero_pd();
+		__m512d Iteration = _mm512_setzero_pd();
+		__mmask8 active = _mm512_cmp_pd_mask(_mm512_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+		__mmask8 inside = 0;
+
+		if (!Julia && (Power == 2))
+		{
+			__m512d xq = _mm512_sub_pd(Cxv, quarter);
+			__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), Zy2);
+			inside = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)), _mm512_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m512d x1 = _mm512_add_pd(Cxv, one);
+			inside |= _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		__m512d Sx = Zx;
+		__m512d Sy = Zy;
+		int nextSave = PeriodicityFirstSave;
+
+		for (int it = 0; (it < iterationMax) && active; it++)
+		{
+			__m512d newZx, newZy, newdZx, newdZy;
+			derivativeStepDoubleAVX512<Power, Julia>(Zx, Zy, dZx, dZy, newdZx, newdZy);
+			formulaStepDoubleAVX512<Power>(Zx, Zy, Zx2, Zy2, Cxv, Cyv, newZx, newZy);
+			Zx = _mm512_mask_blend_pd(active, Zx, newZx);
+			Zy = _mm512_mask_blend_pd(active, Zy, newZy);
+			dZx = _mm512_mask_blend_pd(active, dZx, newdZx);
+			dZy = _mm512_mask_blend_pd(active, dZy, newdZy);
+			Zx2 = _mm512_mul_pd(Zx, Zx);
+			Zy2 = _mm512_mul_pd(Zy, Zy);
+			Iteration = _mm512_mask_add_pd(Iteration, active, Iteration, one);
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(Zx2, Zy2), ER2, _CMP_LT_OQ);
+
+			if (checkPeriodicity)
+			{
+				__m512d dx = _mm512_sub_pd(Zx, Sx);
+				__m512d dy = _mm512_sub_pd(Zy, Sy);
+				__mmask8 periodic = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ);
+				inside |= periodic;
+				active &= ~periodic;
+				if (it == nextSave)
+				{
+					Sx = Zx;
+					Sy = Zy;
+					nextSave *= 2;
+				}
+			}
+		}
+
+		Iteration = _mm512_mask_mov_pd(Iteration, inside, maxIteration);
+		checkPeriodicity = (_mm512_cmp_pd_mask(Iteration, maxIteration, _CMP_EQ_OQ) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), _mm512_cvtpd_epi32(Iteration));
+		_mm256_storeu_ps(outZx + i, _mm512_cvtpd_ps(Zx));
+		_mm256_storeu_ps(outZy + i, _mm512_cvtpd_ps(Zy));
+
+		double laneZx[8], laneZy[8], lanedZx[8], lanedZy[8];
+		_mm512_storeu_pd(laneZx, Zx);
+		_mm512_storeu_pd(laneZy, Zy);
+		_mm512_storeu_pd(lanedZx, dZx);
+		_mm512_storeu_pd(lanedZy, dZy);
+		for (int k = 0; k < 8; k++)
+		{
+			outDistance[i + k] = (iterations[i + k] < iterationMax) ? distanceEstimate(laneZx[k], laneZy[k], lanedZx[k], lanedZy[k]) : 0.0f;
+		}
+	}
+	distanceLineScalarRange<Power, Julia>(startCx, startCy, Dx, Dy, juliaCx, juliaCy, i, count, iterationMax, iterations, outZx, outZy, outDistance);
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+// kernels of every formula for one scalar type and kernel kind, indexed by [julia][power - 2]
+template<typename Function>
+struct FormulaKernels
+{
+	Function	kernels[2][MandelbrotFormulaMaxPower - 1];
+
+	Function	Get(const MandelbrotFormula& formula) const
+	{
+		int power = std::min(std::max(formula.power, 2), MandelbrotFormulaMaxPower);
+		return kernels[formula.julia ? 1 : 0][power - 2];
+	}
+};
+
+// every <Power, Julia> instance of a kernel template, one fully inlined kernel per formula
+static_assert(MandelbrotFormulaMaxPower == 5, "MANDELBROT_FORMULA_KERNELS must list every power");
+#define MANDELBROT_FORMULA_KERNELS(kernel) { { { kernel<2, false>, kernel<3, false>, kernel<4, false>, kernel<5, false> }, { kernel<2, true>, kernel<3, true>, kernel<4, true>, kernel<5, true> } } }
+
+// choose the best available line kernels once for each scalar type and kernel kind
+template<typename Function>
+FormulaKernels<Function>	selectKernels(const FormulaKernels<Function>& avx512, const FormulaKernels<Function>& avx2, const FormulaKernels<Function>& scalar)
+{
+#ifdef MANDELBROT_X86_SIMD
+	if (MandelbrotCPUSupports(true))
+	{
+		return avx512;
+	}
+	if (MandelbrotCPUSupports(false))
+	{
+		return avx2;
+	}
+#endif
+	return scalar;
+}
+
+#ifdef MANDELBROT_X86_SIMD
+FormulaKernels<iterationLineFunction<float>>		gIterationLineFloat = selectKernels<iterationLineFunction<float>>(MANDELBROT_FORMULA_KERNELS(iterationLineAVX512), MANDELBROT_FORMULA_KERNELS(iterationLineAVX2), MANDELBROT_FORMULA_KERNELS(iterationLineScalar));
+FormulaKernels<iterationLineFunction<double>>		gIterationLineDouble = selectKernels<iterationLineFunction<double>>(MANDELBROT_FORMULA_KERNELS(iterationLineDoubleAVX512), MANDELBROT_FORMULA_KERNELS(iterationLineDoubleAVX2), MANDELBROT_FORMULA_KERNELS(iterationLineScalar));
+FormulaKernels<iterationLineFunction<DoubleDouble>>	gIterationLineDoubleDouble = selectKernels<iterationLineFunction<DoubleDouble>>(MANDELBROT_FORMULA_KERNELS(iterationLineDoubleDoubleAVX512), MANDELBROT_FORMULA_KERNELS(iterationLineDoubleDoubleAVX2), MANDELBROT_FORMULA_KERNELS(iterationLineScalar));
+FormulaKernels<distanceLineFunction<float>>			gDistanceLineFloat = selectKernels<distanceLineFunction<float>>(MANDELBROT_FORMULA_KERNELS(distanceLineAVX512), MANDELBROT_FORMULA_KERNELS(distanceLineAVX2), MANDELBROT_FORMULA_KERNELS(distanceLineScalar));
+FormulaKernels<distanceLineFunction<double>>		gDistanceLineDouble = selectKernels<distanceLineFunction<double>>(MANDELBROT_FORMULA_KERNELS(distanceLineDoubleAVX512), MANDELBROT_FORMULA_KERNELS(distanceLineDoubleAVX2), MANDELBROT_FORMULA_KERNELS(distanceLineScalar));
+#else
+FormulaKernels<iterationLineFunction<float>>		gIterationLineFloat = MANDELBROT_FORMULA_KERNELS(iterationLineScalar);
+FormulaKernels<iterationLineFunction<double>>		gIterationLineDouble = MANDELBROT_FORMULA_KERNELS(iterationLineScalar);
+FormulaKernels<iterationLineFunction<DoubleDouble>>	gIterationLineDoubleDouble = MANDELBROT_FORMULA_KERNELS(iterationLineScalar);
+FormulaKernels<distanceLineFunction<float>>			gDistanceLineFloat = MANDELBROT_FORMULA_KERNELS(distanceLineScalar);
+FormulaKernels<distanceLineFunction<double>>		gDistanceLineDouble = MANDELBROT_FORMULA_KERNELS(distanceLineScalar);
+#endif
+// double-double distance estimation is rare enough (over DoubleZoomLimit without perturbation) to stay scalar
+FormulaKernels<distanceLineFunction<DoubleDouble>>	gDistanceLineDoubleDouble = MANDELBROT_FORMULA_KERNELS(distanceLineScalar);
+
+template<>
+void	MandelbrotIterateLine<float>(float startCx, float startCy, float Dx, float Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, const MandelbrotFormula& formula)
+{
+	gIterationLineFloat.Get(formula)(startCx, startCy, Dx, Dy, (float)formula.juliaCx, (float)formula.juliaCy, count, iterationMax, iterations, Zx, Zy);
+}
+
+template<>
+void	MandelbrotIterateLine<double>(double startCx, double startCy, double Dx, double Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, const MandelbrotFormula& formula)
+{
+	gIterationLineDouble.Get(formula)(startCx, startCy, Dx, Dy, formula.juliaCx, formula.juliaCy, count, iterationMax, iterations, Zx, Zy);
+}
+
+template<>
+void	MandelbrotIterateLine<DoubleDouble>(DoubleDouble startCx, DoubleDouble startCy, DoubleDouble Dx, DoubleDouble Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, const MandelbrotFormula& formula)
+{
+	gIterationLineDoubleDouble.Get(formula)(startCx, startCy, Dx, Dy, DoubleDouble(formula.juliaCx), DoubleDouble(formula.juliaCy), count, iterationMax, iterations, Zx, Zy);
+}
+
+template<>
+void	MandelbrotIterateLineDistance<float>(float startCx, float startCy, float Dx, float Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance, const MandelbrotFormula& formula)
+{
+	gDistanceLineFloat.Get(formula)(startCx, startCy, Dx, Dy, (float)formula.juliaCx, (float)formula.juliaCy, count, iterationMax, iterations, Zx, Zy, distance);
+}
+
+template<>
+void	MandelbrotIterateLineDistance<double>(double startCx, double startCy, double Dx, double Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance, const MandelbrotFormula& formula)
+{
+	gDistanceLineDouble.Get(formula)(startCx, startCy, Dx, Dy, formula.juliaCx, formula.juliaCy, count, iterationMax, iterations, Zx, Zy, distance);
+}
+
+template<>
+void	MandelbrotIterateLineDistance<DoubleDouble>(DoubleDouble startCx, DoubleDouble startCy, DoubleDouble Dx, DoubleDouble Dy, int count, int iterationMax, int* iterations, float* Zx, float* Zy, float* distance, const MandelbrotFormula& formula)
+{
+	gDistanceLineDoubleDouble.Get(formula)(startCx, startCy, Dx, Dy, DoubleDouble(formula.juliaCx), DoubleDouble(formula.juliaCy), count, iterationMax, iterations, Zx, Zy, distance);
+}
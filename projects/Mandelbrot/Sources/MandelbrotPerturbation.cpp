@@ -0,0 +1,588 @@
+#include <math.h>
+#include <algorithm>
+#include "MandelbrotPerturbation.h"
+#include "MandelbrotDraw.h"
+#include "MandelbrotSIMD.h"
+
+using namespace Kigs;
+
+// series approximation is stopped when the third order term is no more negligible
+const double SeriesTolerance = 1.0e-6;
+
+// orbits coming back closer than this (in pixel size) to a saved point are considered periodic (inside)
+const double PeriodicityPixelTolerance = 2.0;
+// saved orbit point is moved forward after this count of iterations, then the interval doubles each time
+const int PeriodicityFirstInterval = 8;
+
+// under this delta range, C in double precision is not precise enough for the analytic cardioid / bulb test
+const double CardioidTestMinDelta = 1.0e-10;
+
+void	ReferenceOrbit::Compute(const FixedPoint& centerX, const FixedPoint& centerY, int iterationMax, double maxDelta)
+{
+	mIterationMax = iterationMax;
+	mMaxDelta = maxDelta;
+	mCenterX = centerX.ToDouble();
+	mCenterY = centerY.ToDouble();
+
+	// pixel iteration count is the number of steps after Z(1) = C, so we need iterationMax + 2 orbit points at most
+	bool sameCenter = !mZx.empty() && (mReferenceX == centerX) && (mReferenceY == centerY);
+	if (!sameCenter)
+	{
+		mReferenceX = centerX;
+		mReferenceY = centerY;
+		mLastZx = FixedPoint();
+		mLastZy = FixedPoint();
+		mEscaped = false;
+		mZx.clear();
+		mZy.clear();
+		mZx.push_back(0.0);
+		mZy.push_back(0.0);
+	}
+
+	mZx.reserve(iterationMax + 2);
+	mZy.reserve(iterationMax + 2);
+
+	const FixedPoint two(2.0);
+	for (int n = (int)mZx.size() - 1; !mEscaped && (n <= iterationMax); n++)
+	{
+		FixedPoint Zx2 = mLastZx * mLastZx;
+		FixedPoint Zy2 = mLastZy * mLastZy;
+		mLastZy = two * mLastZx * mLastZy + centerY;
+		mLastZx = Zx2 - Zy2 + centerX;
+
+		double dx = mLastZx.ToDouble();
+		double dy = mLastZy.ToDouble();
+		mZx.push_back(dx);
+		mZy.push_back(dy);
+
+		// escaped reference, pixels will rebase when reaching its end
+		mEscaped = (dx * dx + dy * dy) > 4.0;
+	}
+
+	// series approximation, A(0) = B(0) = C(0) = 0
+	double A[2] = { 0.0,0.0 };
+	double B[2] = { 0.0,0.0 };
+	double C[2] = { 0.0,0.0 };
+
+	mSkippedIterations = 0;
+	mA[0] = mA[1] = mB[0] = mB[1] = mC[0] = mC[1] = 0.0;
+
+	double maxDelta2 = maxDelta * maxDelta;
+	double maxDelta3 = maxDelta2 * maxDelta;
+
+	// keep at least one orbit point after the skipped iterations
+	// (a reused orbit can be longer than this iteration max needs, the approximation stays the same as a new orbit)
+	int lastUsable = std::min((int)mZx.size(), iterationMax + 2) - 2;
+	for (int n = 0; n < lastUsable; n++)
+	{
+		double Zx = mZx[n];
+		double Zy = mZy[n];
+
+		// A' = 2ZA + 1
+		double nA[2] = { 2.0 * (Zx * A[0] - Zy * A[1]) + 1.0, 2.0 * (Zx * A[1] + Zy * A[0]) };
+		// B' = 2ZB + A^2
+		double nB[2] = { 2.0 * (Zx * B[0] - Zy * B[1]) + A[0] * A[0] - A[1] * A[1], 2.0 * (Zx * B[1] + Zy * B[0]) + 2.0 * A[0] * A[1] };
+		// C' = 2ZC + 2AB
+		double nC[2] = { 2.0 * (Zx * C[0] - Zy * C[1]) + 2.0 * (A[0] * B[0] - A[1] * B[1]), 2.0 * (Zx * C[1] + Zy * C[0]) + 2.0 * (A[0] * B[1] + A[1] * B[0]) };
+
+		double normB = sqrt(nB[0] * nB[0] + nB[1] * nB[1]);
+		double normC = sqrt(nC[0] * nC[0] + nC[1] * nC[1]);
+
+		if ((normC * maxDelta3) > (SeriesTolerance * normB * maxDelta2))
+		{
+			break;
+		}
+		if (!isfinite(normC))
+		{
+			break;
+		}
+
+		A[0] = nA[0]; A[1] = nA[1];
+		B[0] = nB[0]; B[1] = nB[1];
+		C[0] = nC[0]; C[1] = nC[1];
+
+		mSkippedIterations = n + 1;
+		mA[0] = A[0]; mA[1] = A[1];
+		mB[0] = B[0]; mB[1] = B[1];
+		mC[0] = C[0]; mC[1] = C[1];
+	}
+
+	// never skip pixels iterations (skipped step 1 is Z = C, iteration count 0)
+	if (mSkippedIterations > iterationMax)
+	{
+		mSkippedIterations = iterationMax;
+	}
+}
+
+// what line kernels need from the reference orbit : pixel i has dc = (startDCx + i * Dx, startDCy + i * Dy)
+struct PerturbationLine
+{
+	const double*	Zx;
+	const double*	Zy;
+	int				lastRef;
+	int				skippedIterations;
+	int				iterationMax;
+	double			A[2];
+	double			B[2];
+	double			C[2];
+	double			centerX;
+	double			centerY;
+	bool			checkCardioid;
+	double			periodicityTolerance2;
+	double			startDCx;
+	double			startDCy;
+	double			Dx;
+	double			Dy;
+};
+
+// iterate pixels [first, count) of the line one by one
+void	perturbationLineScalarRange(const PerturbationLine& line, int first, int count, int* iterations, float* outZx, float* outZy)
+{
+	const double ER2 = 4.0;
+
+	// periodicity checking costs a few operations per iteration, so it's only done after an inside pixel
+	bool checkPeriodicity = true;
+
+	for (int i = first; i < count; i++)
+	{
+		double DCx = line.startDCx + i * line.Dx;
+		double DCy = line.startDCy + i * line.Dy;
+
+		if (line.checkCardioid && MandelbrotInsideCardioidOrBulb(line.centerX + DCx, line.centerY + DCy))
+		{
+			iterations[i] = line.iterationMax;
+			outZx[i] = (float)(line.centerX + DCx);
+			outZy[i] = (float)(line.centerY + DCy);
+			checkPeriodicity = true;
+			continue;
+		}
+
+		// start from series approximation
+		double DC2x = DCx * DCx - DCy * DCy;
+		double DC2y = 2.0 * DCx * DCy;
+		double DC3x = DC2x * DCx - DC2y * DCy;
+		double DC3y = DC2x * DCy + DC2y * DCx;
+
+		double dzx = line.A[0] * DCx - line.A[1] * DCy + line.B[0] * DC2x - line.B[1] * DC2y + line.C[0] * DC3x - line.C[1] * DC3y;
+		double dzy = line.A[0] * DCy + line.A[1] * DCx + line.B[0] * DC2y + line.B[1] * DC2x + line.C[0] * DC3y + line.C[1] * DC3x;
+
+		int refIndex = line.skippedIterations;
+		int step = line.skippedIterations;
+		double Zx = 0.0;
+		double Zy = 0.0;
+
+		// saved orbit point for Brent periodicity check (first one is saved on next step)
+		double Sx = 1.0e10;
+		double Sy = 1.0e10;
+		int nextSave = step + 1;
+		int saveInterval = PeriodicityFirstInterval;
+		bool periodic = false;
+
+		while (true)
+		{
+			double Rx = line.Zx[refIndex];
+			double Ry = line.Zy[refIndex];
+			Zx = Rx + dzx;
+			Zy = Ry + dzy;
+			double Z2 = Zx * Zx + Zy * Zy;
+
+			// step 1 is Z = C, iteration count is step - 1
+			if (step >= 1)
+			{
+				if ((Z2 >= ER2) || ((step - 1) >= line.iterationMax))
+				{
+					break;
+				}
+
+				if (checkPeriodicity)
+				{
+					double dx = Zx - Sx;
+					double dy = Zy - Sy;
+					if ((dx * dx + dy * dy) < line.periodicityTolerance2)
+					{
+						periodic = true;
+						break;
+					}
+					if (step >= nextSave)
+					{
+						Sx = Zx;
+						Sy = Zy;
+						nextSave = step + saveInterval;
+						saveInterval *= 2;
+					}
+				}
+			}
+
+			// rebase when the pixel orbit is closer to 0 than to the reference, or at the end of the reference
+			if ((Z2 < (dzx * dzx + dzy * dzy)) || (refIndex == line.lastRef))
+			{
+				dzx = Zx;
+				dzy = Zy;
+				refIndex = 0;
+				Rx = 0.0;
+				Ry = 0.0;
+			}
+
+			// dz = 2 Z dz + dz^2 + dc
+			double ndzx = 2.0 * (Rx * dzx - Ry * dzy) + (dzx * dzx - dzy * dzy) + DCx;
+			double ndzy = 2.0 * (Rx * dzy + Ry * dzx) + 2.0 * dzx * dzy + DCy;
+			dzx = ndzx;
+			dzy = ndzy;
+			refIndex++;
+			step++;
+		}
+
+		iterations[i] = periodic ? line.iterationMax : step - 1;
+		checkPeriodicity = (iterations[i] == line.iterationMax);
+		outZx[i] = (float)Zx;
+		outZy[i] = (float)Zy;
+	}
+}
+
+void	perturbationLineScalar(const PerturbationLine& line, int count, int* iterations, float* outZx, float* outZy)
+{
+	perturbationLineScalarRange(line, 0, count, iterations, outZx, outZy);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+// 4 pixels at a time : same steps as the scalar loop, all lanes share the step count but each one has its own
+// reference index (lanes rebase independently). Until a lane rebases alone, all active lanes use the same
+// reference point which is broadcast, then reference points are gathered (much slower).
+// Reference indices and iteration counts are kept as doubles so they use the same lanes as Z
+MANDELBROT_TARGET("avx2")
+void	perturbationLineAVX2(const PerturbationLine& line, int count, int* iterations, float* outZx, float* outZy)
+{
+	const __m256d ER2 = _mm256_set1_pd(4.0);
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d sixteenth = _mm256_set1_pd(0.0625);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d allLanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+	const __m256d tolerance2 = _mm256_set1_pd(line.periodicityTolerance2);
+	const __m256d maxIteration = _mm256_set1_pd((double)line.iterationMax);
+	const __m256d lastRef = _mm256_set1_pd((double)line.lastRef);
+	const __m256d lanes = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+	const __m256d Ax = _mm256_set1_pd(line.A[0]);
+	const __m256d Ay = _mm256_set1_pd(line.A[1]);
+	const __m256d Bx = _mm256_set1_pd(line.B[0]);
+	const __m256d By = _mm256_set1_pd(line.B[1]);
+	const __m256d Cx = _mm256_set1_pd(line.C[0]);
+	const __m256d Cy = _mm256_set1_pd(line.C[1]);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d index = _mm256_add_pd(_mm256_set1_pd((double)i), lanes);
+		__m256d DCx = _mm256_add_pd(_mm256_set1_pd(line.startDCx), _mm256_mul_pd(index, _mm256_set1_pd(line.Dx)));
+		__m256d DCy = _mm256_add_pd(_mm256_set1_pd(line.startDCy), _mm256_mul_pd(index, _mm256_set1_pd(line.Dy)));
+
+		// inside lanes keep C as last Z
+		__m256d Zx = _mm256_add_pd(_mm256_set1_pd(line.centerX), DCx);
+		__m256d Zy = _mm256_add_pd(_mm256_set1_pd(line.centerY), DCy);
+		__m256d active = allLanes;
+		if (line.checkCardioid)
+		{
+			__m256d Zy2 = _mm256_mul_pd(Zy, Zy);
+			__m256d xq = _mm256_sub_pd(Zx, quarter);
+			__m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), Zy2);
+			__m256d inCardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)), _mm256_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m256d x1 = _mm256_add_pd(Zx, one);
+			__m256d inBulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active = _mm256_andnot_pd(_mm256_or_pd(inCardioid, inBulb), active);
+		}
+
+		// start from series approximation
+		__m256d DC2x = _mm256_sub_pd(_mm256_mul_pd(DCx, DCx), _mm256_mul_pd(DCy, DCy));
+		__m256d DC2y = _mm256_mul_pd(two, _mm256_mul_pd(DCx, DCy));
+		__m256d DC3x = _mm256_sub_pd(_mm256_mul_pd(DC2x, DCx), _mm256_mul_pd(DC2y, DCy));
+		__m256d DC3y = _mm256_add_pd(_mm256_mul_pd(DC2x, DCy), _mm256_mul_pd(DC2y, DCx));
+		__m256d dzx = _mm256_sub_pd(_mm256_mul_pd(Ax, DCx), _mm256_mul_pd(Ay, DCy));
+		dzx = _mm256_sub_pd(_mm256_add_pd(dzx, _mm256_mul_pd(Bx, DC2x)), _mm256_mul_pd(By, DC2y));
+		dzx = _mm256_sub_pd(_mm256_add_pd(dzx, _mm256_mul_pd(Cx, DC3x)), _mm256_mul_pd(Cy, DC3y));
+		__m256d dzy = _mm256_add_pd(_mm256_mul_pd(Ax, DCy), _mm256_mul_pd(Ay, DCx));
+		dzy = _mm256_add_pd(_mm256_add_pd(dzy, _mm256_mul_pd(Bx, DC2y)), _mm256_mul_pd(By, DC2x));
+		dzy = _mm256_add_pd(_mm256_add_pd(dzy, _mm256_mul_pd(Cx, DC3y)), _mm256_mul_pd(Cy, DC3x));
+
+		// lanes still active at iteration max, or found periodic, keep iteration max
+		__m256d Iteration = maxIteration;
+		__m256d ref = _mm256_set1_pd((double)line.skippedIterations);
+		__m256d Sx = _mm256_set1_pd(1.0e10);
+		__m256d Sy = _mm256_set1_pd(1.0e10);
+		int nextSave = line.skippedIterations + 1;
+		int saveInterval = PeriodicityFirstInterval;
+		// reference index of all active lanes while uniform is set
+		bool uniform = true;
+		int sharedRef = line.skippedIterations;
+
+		for (int step = line.skippedIterations; _mm256_movemask_pd(active) != 0; step++)
+		{
+			__m256d Rx, Ry;
+			if (uniform)
+			{
+				Rx = _mm256_set1_pd(line.Zx[sharedRef]);
+				Ry = _mm256_set1_pd(line.Zy[sharedRef]);
+			}
+			else
+			{
+				__m128i refIndex = _mm256_cvttpd_epi32(ref);
+				Rx = _mm256_i32gather_pd(line.Zx, refIndex, 8);
+				Ry = _mm256_i32gather_pd(line.Zy, refIndex, 8);
+			}
+			__m256d newZx = _mm256_add_pd(Rx, dzx);
+			__m256d newZy = _mm256_add_pd(Ry, dzy);
+			__m256d Z2 = _mm256_add_pd(_mm256_mul_pd(newZx, newZx), _mm256_mul_pd(newZy, newZy));
+			Zx = _mm256_blendv_pd(Zx, newZx, active);
+			Zy = _mm256_blendv_pd(Zy, newZy, active);
+
+			// step 1 is Z = C, iteration count is step - 1
+			if (step >= 1)
+			{
+				if ((step - 1) >= line.iterationMax)
+				{
+					break;
+				}
+				__m256d escaped = _mm256_and_pd(active, _mm256_cmp_pd(Z2, ER2, _CMP_GE_OQ));
+				Iteration = _mm256_blendv_pd(Iteration, _mm256_set1_pd((double)(step - 1)), escaped);
+				active = _mm256_andnot_pd(escaped, active);
+
+				if (checkPeriodicity)
+				{
+					__m256d dx = _mm256_sub_pd(newZx, Sx);
+					__m256d dy = _mm256_sub_pd(newZy, Sy);
+					active = _mm256_andnot_pd(_mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ), active);
+					if (step >= nextSave)
+					{
+						Sx = newZx;
+						Sy = newZy;
+						nextSave = step + saveInterval;
+						saveInterval *= 2;
+					}
+				}
+			}
+
+			// rebase when the pixel orbit is closer to 0 than to the reference, or at the end of the reference
+			__m256d dz2 = _mm256_add_pd(_mm256_mul_pd(dzx, dzx), _mm256_mul_pd(dzy, dzy));
+			__m256d rebase = _mm256_or_pd(_mm256_cmp_pd(Z2, dz2, _CMP_LT_OQ), _mm256_cmp_pd(ref, lastRef, _CMP_EQ_OQ));
+			dzx = _mm256_blendv_pd(dzx, newZx, rebase);
+			dzy = _mm256_blendv_pd(dzy, newZy, rebase);
+			Rx = _mm256_andnot_pd(rebase, Rx);
+			Ry = _mm256_andnot_pd(rebase, Ry);
+			ref = _mm256_andnot_pd(rebase, ref);
+			if (uniform)
+			{
+				int activeLanes = _mm256_movemask_pd(active);
+				int rebased = _mm256_movemask_pd(rebase) & activeLanes;
+				uniform = (rebased == 0) || (rebased == activeLanes);
+				sharedRef = (rebased == 0) ? sharedRef : 0;
+			}
+
+			// dz = 2 Z dz + dz^2 + dc, finished lanes are frozen (their reference index must stay valid)
+			__m256d ndzx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(two, _mm256_sub_pd(_mm256_mul_pd(Rx, dzx), _mm256_mul_pd(Ry, dzy))), _mm256_sub_pd(_mm256_mul_pd(dzx, dzx), _mm256_mul_pd(dzy, dzy))), DCx);
+			__m256d ndzy = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(Rx, dzy), _mm256_mul_pd(Ry, dzx))), _mm256_mul_pd(_mm256_mul_pd(two, dzx), dzy)), DCy);
+			dzx = _mm256_blendv_pd(dzx, ndzx, active);
+			dzy = _mm256_blendv_pd(dzy, ndzy, active);
+			ref = _mm256_add_pd(ref, _mm256_and_pd(active, one));
+			sharedRef++;
+		}
+
+		checkPeriodicity = (_mm256_movemask_pd(_mm256_cmp_pd(Iteration, maxIteration, _CMP_EQ_OQ)) != 0);
+
+		_mm_storeu_si128((__m128i*)(iterations + i), _mm256_cvtpd_epi32(Iteration));
+		_mm_storeu_ps(outZx + i, _mm256_cvtpd_ps(Zx));
+		_mm_storeu_ps(outZy + i, _mm256_cvtpd_ps(Zy));
+	}
+	perturbationLineScalarRange(line, i, count, iterations, outZx, outZy);
+}
+
+// same as the AVX2 kernel, 8 pixels at a time with mask registers
+MANDELBROT_TARGET("avx512f")
+void	perturbationLineAVX512(const PerturbationLine& line, int count, int* iterations, float* outZx, float* outZy)
+{
+	const __m512d ER2 = _mm512_set1_pd(4.0);
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	const __m512d sixteenth = _mm512_set1_pd(0.0625);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d two = _mm512_set1_pd(2.0);
+	const __m512d tolerance2 = _mm512_set1_pd(line.periodicityTolerance2);
+	const __m512d maxIteration = _mm512_set1_pd((double)line.iterationMax);
+	const __m512d lastRef = _mm512_set1_pd((double)line.lastRef);
+	const __m512d lanes = _mm512_setr_pd(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0);
+	const __m512d Ax = _mm512_set1_pd(line.A[0]);
+	const __m512d Ay = _mm512_set1_pd(line.A[1]);
+	const __m512d Bx = _mm512_set1_pd(line.B[0]);
+	const __m512d By = _mm512_set1_pd(line.B[1]);
+	const __m512d Cx = _mm512_set1_pd(line.C[0]);
+	const __m512d Cy = _mm512_set1_pd(line.C[1]);
+
+	bool checkPeriodicity = true;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m512d index = _mm512_add_pd(_mm512_set1_pd((double)i), lanes);
+		__m512d DCx = _mm512_add_pd(_mm512_set1_pd(line.startDCx), _mm512_mul_pd(index, _mm512_set1_pd(line.Dx)));
+		__m512d DCy = _mm512_add_pd(_mm512_set1_pd(line.startDCy), _mm512_mul_pd(index, _mm512_set1_pd(line.Dy)));
+
+		// inside lanes keep C as last Z
+		__m512d Zx = _mm512_add_pd(_mm512_set1_pd(line.centerX), DCx);
+		__m512d Zy = _mm512_add_pd(_mm512_set1_pd(line.centerY), DCy);
+		__mmask8 active = 0xFF;
+		if (line.checkCardioid)
+		{
+			__m512d Zy2 = _mm512_mul_pd(Zy, Zy);
+			__m512d xq = _mm512_sub_pd(Zx, quarter);
+			__m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), Zy2);
+			__mmask8 inside = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)), _mm512_mul_pd(quarter, Zy2), _CMP_LT_OQ);
+			__m512d x1 = _mm512_add_pd(Zx, one);
+			inside |= _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x1, x1), Zy2), sixteenth, _CMP_LT_OQ);
+			active &= ~inside;
+		}
+
+		// start from series approximation
+		__m512d DC2x = _mm512_sub_pd(_mm512_mul_pd(DCx, DCx), _mm512_mul_pd(DCy, DCy));
+		__m512d DC2y = _mm512_mul_pd(two, _mm512_mul_pd(DCx, DCy));
+		__m512d DC3x = _mm512_sub_pd(_mm512_mul_pd(DC2x, DCx), _mm512_mul_pd(DC2y, DCy));
+		__m512d DC3y = _mm512_add_pd(_mm512_mul_pd(DC2x, DCy), _mm512_mul_pd(DC2y, DCx));
+		__m512d dzx = _mm512_sub_pd(_mm512_mul_pd(Ax, DCx), _mm512_mul_pd(Ay, DCy));
+		dzx = _mm512_sub_pd(_mm512_add_pd(dzx, _mm512_mul_pd(Bx, DC2x)), _mm512_mul_pd(By, DC2y));
+		dzx = _mm512_sub_pd(_mm512_add_pd(dzx, _mm512_mul_pd(Cx, DC3x)), _mm512_mul_pd(Cy, DC3y));
+		__m512d dzy = _mm512_add_pd(_mm512_mul_pd(Ax, DCy), _mm512_mul_pd(Ay, DCx));
+		dzy = _mm512_add_pd(_mm512_add_pd(dzy, _mm512_mul_pd(Bx, DC2y)), _mm512_mul_pd(By, DC2x));
+		dzy = _mm512_add_pd(_mm512_add_pd(dzy, _mm512_mul_pd(Cx, DC3y)), _mm512_mul_pd(Cy, DC3x));
+
+		// lanes still active at iteration max, or found periodic, keep iteration max
+		__m512d Iteration = maxIteration;
+		__m512d ref = _mm512_set1_pd((double)line.skippedIterations);
+		__m512d Sx = _mm512_set1_pd(1.0e10);
+		__m512d Sy = _mm512_set1_pd(1.0e10);
+		int nextSave = line.skippedIterations + 1;
+		int saveInterval = PeriodicityFirstInterval;
+		// reference index of all active lanes while uniform is set
+		bool uniform = true;
+		int sharedRef = line.skippedIterations;
+
+		for (int step = line.skippedIterations; active; step++)
+		{
+			__m512d Rx, Ry;
+			if (uniform)
+			{
+				Rx = _mm512_set1_pd(line.Zx[sharedRef]);
+				Ry = _mm512_set1_pd(line.Zy[sharedRef]);
+			}
+			else
+			{
+				__m256i refIndex = _mm512_cvttpd_epi32(ref);
+				Rx = _mm512_i32gather_pd(refIndex, line.Zx, 8);
+				Ry = _mm512_i32gather_pd(refIndex, line.Zy, 8);
+			}
+			__m512d newZx = _mm512_add_pd(Rx, dzx);
+			__m512d newZy = _mm512_add_pd(Ry, dzy);
+			__m512d Z2 = _mm512_add_pd(_mm512_mul_pd(newZx, newZx), _mm512_mul_pd(newZy, newZy));
+			Zx = _mm512_mask_blend_pd(active, Zx, newZx);
+			Zy = _mm512_mask_blend_pd(active, Zy, newZy);
+
+			// step 1 is Z = C, iteration count is step - 1
+			if (step >= 1)
+			{
+				if ((step - 1) >= line.iterationMax)
+				{
+					break;
+				}
+				__mmask8 escaped = _mm512_mask_cmp_pd_mask(active, Z2, ER2, _CMP_GE_OQ);
+				Iteration = _mm512_mask_mov_pd(Iteration, escaped, _mm512_set1_pd((double)(step - 1)));
+				active &= ~escaped;
+
+				if (checkPeriodicity)
+				{
+					__m512d dx = _mm512_sub_pd(newZx, Sx);
+					__m512d dy = _mm512_sub_pd(newZy, Sy);
+					active &= ~_mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), tolerance2, _CMP_LT_OQ);
+					if (step >= nextSave)
+					{
+						Sx = newZx;
+						Sy = newZy;
+						nextSave = step + saveInterval;
+						saveInterval *= 2;
+					}
+				}
+			}
+
+			// rebase when the pixel orbit is closer to 0 than to the reference, or at the end of the reference
+			__m512d dz2 = _mm512_add_pd(_mm512_mul_pd(dzx, dzx), _mm512_mul_pd(dzy, dzy));
+			__mmask8 rebase = _mm512_cmp_pd_mask(Z2, dz2, _CMP_LT_OQ) | _mm512_cmp_pd_mask(ref, lastRef, _CMP_EQ_OQ);
+			dzx = _mm512_mask_mov_pd(dzx, rebase, newZx);
+			dzy = _mm512_mask_mov_pd(dzy, rebase, newZy);
+			Rx = _mm512_maskz_mov_pd((__mmask8)~rebase, Rx);
+			Ry = _mm512_maskz_mov_pd((__mmask8)~rebase, Ry);
+			ref = _mm512_maskz_mov_pd((__mmask8)~rebase, ref);
+			if (uniform)
+			{
+				__mmask8 rebased = rebase & active;
+				uniform = (rebased == 0) || (rebased == active);
+				sharedRef = (rebased == 0) ? sharedRef : 0;
+			}
+
+			// dz = 2 Z dz + dz^2 + dc, finished lanes are frozen (their reference index must stay valid)
+			__m512d ndzx = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(two, _mm512_sub_pd(_mm512_mul_pd(Rx, dzx), _mm512_mul_pd(Ry, dzy))), _mm512_sub_pd(_mm512_mul_pd(dzx, dzx), _mm512_mul_pd(dzy, dzy))), DCx);
+			__m512d ndzy = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(Rx, dzy), _mm512_mul_pd(Ry, dzx))), _mm512_mul_pd(_mm512_mul_pd(two, dzx), dzy)), DCy);
+			dzx = _mm512_mask_mov_pd(dzx, active, ndzx);
+			dzy = _mm512_mask_mov_pd(dzy, active, ndzy);
+			ref = _mm512_mask_add_pd(ref, active, ref, one);
+			sharedRef++;
+		}
+
+		checkPeriodicity = (_mm512_cmp_pd_mask(Iteration, maxIteration, _CMP_EQ_OQ) != 0);
+
+		_mm256_storeu_si256((__m256i*)(iterations + i), _mm512_cvtpd_epi32(Iteration));
+		_mm256_storeu_ps(outZx + i, _mm512_cvtpd_ps(Zx));
+		_mm256_storeu_ps(outZy + i, _mm512_cvtpd_ps(Zy));
+	}
+	perturbationLineScalarRange(line, i, count, iterations, outZx, outZy);
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+using perturbationLineFunction = void (*)(const PerturbationLine& line, int count, int* iterations, float* Zx, float* Zy);
+
+// choose the best available line kernel once
+perturbationLineFunction	selectPerturbationLine()
+{
+#ifdef MANDELBROT_X86_SIMD
+	if (MandelbrotCPUSupports(true))
+	{
+		return perturbationLineAVX512;
+	}
+	if (MandelbrotCPUSupports(false))
+	{
+		return perturbationLineAVX2;
+	}
+#endif
+	return perturbationLineScalar;
+}
+
+perturbationLineFunction	gPerturbationLine = selectPerturbationLine();
+
+void	ReferenceOrbit::IterateLine(double startDCx, double startDCy, double Dx, double Dy, int count, int* iterations, float* outZx, float* outZy) const
+{
+	PerturbationLine line;
+	line.Zx = mZx.data();
+	line.Zy = mZy.data();
+	line.lastRef = (int)mZx.size() - 1;
+	line.skippedIterations = mSkippedIterations;
+	line.iterationMax = mIterationMax;
+	line.A[0] = mA[0]; line.A[1] = mA[1];
+	line.B[0] = mB[0]; line.B[1] = mB[1];
+	line.C[0] = mC[0]; line.C[1] = mC[1];
+	line.centerX = mCenterX;
+	line.centerY = mCenterY;
+	line.checkCardioid = (mMaxDelta > CardioidTestMinDelta);
+	double periodicityTolerance = PeriodicityPixelTolerance * sqrt(Dx * Dx + Dy * Dy);
+	line.periodicityTolerance2 = periodicityTolerance * periodicityTolerance;
+	line.startDCx = startDCx;
+	line.startDCy = startDCy;
+	line.Dx = Dx;
+	line.Dy = Dy;
+
+	gPerturbationLine(line, count, iterations, outZx, outZy);
+}
@@ -0,0 +1,229 @@
+#include <string.h>
+#include <chrono>
+#include "MandelbrotRenderThread.h"
+
+#ifdef MANDELBROT_RENDER_THREAD
+#define MANDELBROT_LOCK std::lock_guard<std::mutex> lock(mMutex)
+#else
+#define MANDELBROT_LOCK
+#endif
+
+MandelbrotRenderThread::MandelbrotRenderThread()
+{
+#ifdef MANDELBROT_RENDER_THREAD
+	mThread = std::thread(&MandelbrotRenderThread::workerLoop, this);
+#endif
+}
+
+MandelbrotRenderThread::~MandelbrotRenderThread()
+{
+	Stop();
+}
+
+void	MandelbrotRenderThread::Stop()
+{
+	{
+		MANDELBROT_LOCK;
+		mQuit = true;
+		mHasPending = false;
+	}
+#ifdef MANDELBROT_RENDER_THREAD
+	mWakeUp.notify_one();
+	if (mThread.joinable())
+	{
+		mThread.join();
+	}
+#endif
+}
+
+void	MandelbrotRenderThread::Request(const MandelbrotView& view)
+{
+	{
+		MANDELBROT_LOCK;
+		mPendingView = view;
+		mHasPending = true;
+		mRequestID++;
+		mCancel = true;
+	}
+#ifdef MANDELBROT_RENDER_THREAD
+	mWakeUp.notify_one();
+#endif
+}
+
+bool	MandelbrotRenderThread::GetFrame(unsigned char* pixelsdata, int sizeX, int sizeY, bool& complete, MandelbrotFrameStats* stats)
+{
+	complete = false;
+
+#ifndef MANDELBROT_RENDER_THREAD
+	workStep();
+#endif
+
+	{
+		MANDELBROT_LOCK;
+		if (!mFrameReady)
+		{
+			return false;
+		}
+		mFrameReady = false;
+		complete = mFrameComplete && (mFrameRequestID == mRequestID);
+		if ((mFrontSizeX != sizeX) || (mFrontSizeY != sizeY))
+		{
+			return false;
+		}
+		mReadPixels.swap(mFrontPixels);
+		if (stats)
+		{
+			*stats = mFrontStats;
+		}
+	}
+
+	// the worker only uses the front buffer under the lock, so the copy can be done without it
+	memcpy(pixelsdata, mReadPixels.data(), mReadPixels.size());
+	return true;
+}
+
+bool	MandelbrotRenderThread::workStep()
+{
+	bool restart = false;
+	{
+		MANDELBROT_LOCK;
+		if (mQuit)
+		{
+			return false;
+		}
+		if (mHasPending)
+		{
+			mCurrentView = mPendingView;
+			mCurrentRequestID = mRequestID;
+			mHasPending = false;
+			mWorking = true;
+			restart = true;
+			mCancel = false;
+		}
+		if (!mWorking)
+		{
+			return false;
+		}
+	}
+
+	bool cancelled = false;
+	bool finished = renderStep(mCurrentView, restart, cancelled);
+	mWorking = !finished;
+	if (cancelled)
+	{
+		// the newer request is taken by next step
+		return true;
+	}
+
+	// swap back and front buffers
+	{
+		MANDELBROT_LOCK;
+		mFrontPixels.swap(mBackPixels);
+		mFrontSizeX = mBackSizeX;
+		mFrontSizeY = mBackSizeY;
+		std::swap(mFrontStats, mBackStats);
+		mFrameReady = true;
+		mFrameRequestID = mCurrentRequestID;
+		mFrameComplete = finished;
+	}
+	return true;
+}
+
+bool	MandelbrotRenderThread::renderStep(const MandelbrotView& view, bool restart, bool& cancelled)
+{
+	const MandelbrotIterationBuffer* result = nullptr;
+	bool finished = true;
+	mBackStats.Reset();
+
+	if (view.progressive)
+	{
+		auto setViewStart = std::chrono::steady_clock::now();
+		if (restart)
+		{
+			mProgressiveRender.SetView(view.sizeX, view.sizeY, view.centerX, view.centerY, view.zoomCoef, view.deep, view.formula, view.distanceEstimation);
+		}
+		std::chrono::duration<double, std::milli> setViewTime = std::chrono::steady_clock::now() - setViewStart;
+		mProgressiveRender.Update(view.progressiveBudget, &mBackStats);
+		// the reference orbit is computed by SetView
+		mBackStats.iterateTime += setViewTime.count();
+		result = &mProgressiveRender.GetBuffer();
+		finished = mProgressiveRender.IsComplete();
+	}
+	else
+	{
+		MandelbrotIterateSettings settings;
+		settings.mode = view.mode;
+		settings.tileSize = view.tileSize;
+		settings.formula = view.formula;
+		settings.distanceEstimation = view.distanceEstimation;
+		settings.cancel = &mCancel;
+		settings.stats = &mBackStats;
+
+		MandelbrotIterationBuffer& buffer = mIterationBuffers[mCurrentBuffer];
+		MandelbrotIterationBuffer& previous = mIterationBuffers[1 - mCurrentBuffer];
+		settings.previous = view.frameCache ? &previous : nullptr;
+		settings.reprojectNeedsZ = (view.texture != nullptr) || view.smooth;
+		if (view.deep)
+		{
+			cancelled = !IterateMandelbrotDeep(buffer, view.sizeX, view.sizeY, view.centerX, view.centerY, view.zoomCoef, mOrbit, settings);
+		}
+		else
+		{
+			cancelled = !IterateMandelbrot(buffer, view.sizeX, view.sizeY, view.centerX, view.centerY, view.zoomCoef, settings);
+		}
+		if (cancelled)
+		{
+			// keep previous buffer as the reprojection source
+			return false;
+		}
+		// float precision frames are not accurate enough to be reused by the following frames
+		if (!view.deep && (MandelbrotPrecisionForZoom(view.zoomCoef) == MandelbrotPrecision::Float))
+		{
+			buffer.Invalidate();
+		}
+		mCurrentBuffer = 1 - mCurrentBuffer;
+		result = &buffer;
+	}
+
+	auto colorizeStart = std::chrono::steady_clock::now();
+	mBackSizeX = result->sizeX;
+	mBackSizeY = result->sizeY;
+	mBackPixels.resize(result->sizeX * result->sizeY * 4);
+	mPalette.Update(result->iterationMax, view.texture, view.smooth, view.formula.power);
+	if (view.equalize)
+	{
+		mPalette.Equalize(*result);
+	}
+	ColorizeMandelbrot(mBackPixels.data(), *result, mPalette);
+	auto colorizeEnd = std::chrono::steady_clock::now();
+	mBackStats.colorizeTime = std::chrono::duration<double, std::milli>(colorizeEnd - colorizeStart).count();
+
+	if (finished && (view.antialias > 0))
+	{
+		MandelbrotAntialiasSettings antialias;
+		antialias.samples = view.antialias;
+		antialias.cancel = &mCancel;
+		const Kigs::ReferenceOrbit* orbit = view.progressive ? mProgressiveRender.GetOrbit() : &mOrbit;
+		cancelled = !AntialiasMandelbrot(mBackPixels.data(), *result, mPalette, orbit, antialias);
+		mBackStats.antialiasTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - colorizeEnd).count();
+	}
+	return finished;
+}
+
+#ifdef MANDELBROT_RENDER_THREAD
+void	MandelbrotRenderThread::workerLoop()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeUp.wait(lock, [this]() { return mQuit || mHasPending || mWorking; });
+			if (mQuit)
+			{
+				return;
+			}
+		}
+		workStep();
+	}
+}
+#endif